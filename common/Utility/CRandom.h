@@ -33,6 +33,7 @@
 #pragma once
 
 #include "UTCommon.h"
+#include <time.h>
 
 //----------------
 // 㷨
@@ -85,9 +86,13 @@ public:
     {
         if(0 == seed)
         {
+#ifdef _WIN32
             LARGE_INTEGER iNow;  iNow.LowPart = 0;  iNow.HighPart = 0;
             QueryPerformanceCounter( &iNow );
             seed = static_cast<Int32>( iNow.LowPart );
+#else
+            seed = static_cast<Int32>( clock() ^ time(NULL) );
+#endif
         }
 
         idum = seed>0 ? -seed : seed;  // make idum negative
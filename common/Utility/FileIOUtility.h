@@ -1,8 +1,21 @@
 #pragma once
 
+#include <condition_variable>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 using namespace std;
 
 template<class ValueType>
@@ -89,6 +102,301 @@ bool LoadBinary(const char* filename, vector<ValueType>& buffer, unsigned int& r
 	}
 }
 
+// file mapped into memory in the rows/cols format of LoadBinary(filename, buffer, rows, cols):
+// unsigned int rows, unsigned int cols, then rows * cols values
+// Open maps an existing file read only (nothing is copied, pages are read when touched),
+// Create makes a new file of rows * cols values and maps it for writing, it is on disk after Close
+template<class ValueType>
+class MappedBinary
+{
+public:
+	MappedBinary() : rows(0), cols(0), base(NULL), size(0)
+	{
+#ifdef _WIN32
+		file = INVALID_HANDLE_VALUE;
+		mapping = NULL;
+#endif
+	}
+	~MappedBinary() { Close(); }
+
+	bool Open(const char* filename)
+	{
+		Close();
+#ifdef _WIN32
+		file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		LARGE_INTEGER file_size;
+		if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &file_size))
+		{
+			cout << "can't open file " << filename << endl;
+			Close();
+			return false;
+		}
+		size = (size_t)file_size.QuadPart;
+#else
+		int fd = open(filename, O_RDONLY);
+		struct stat st;
+		if (fd < 0 || fstat(fd, &st) != 0)
+		{
+			cout << "can't open file " << filename << endl;
+			if (fd >= 0) close(fd);
+			return false;
+		}
+		size = (size_t)st.st_size;
+#endif
+		if (size < 2 * sizeof(unsigned int))
+		{
+			cout << "fail to load binary row and col number from " << filename << endl;
+#ifndef _WIN32
+			close(fd);
+#endif
+			Close();
+			return false;
+		}
+#ifdef _WIN32
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		base = mapping == NULL ? NULL : (char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+		void* p = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		base = p == MAP_FAILED ? NULL : (char*)p;
+		if (base != NULL)
+			madvise(base, size, MADV_SEQUENTIAL);
+#endif
+		if (base == NULL)
+		{
+			cout << "fail to map " << filename << endl;
+			Close();
+			return false;
+		}
+		rows = ((const unsigned int*)base)[0];
+		cols = ((const unsigned int*)base)[1];
+		if ((size - 2 * sizeof(unsigned int)) / sizeof(ValueType) < (size_t)rows * cols)
+		{
+			cout << "fail to load binary from " << filename << endl;
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	bool Create(const char* filename, unsigned int rows_, unsigned int cols_)
+	{
+		Close();
+		size = 2 * sizeof(unsigned int) + (size_t)rows_ * cols_ * sizeof(ValueType);
+#ifdef _WIN32
+		file = CreateFileA(filename, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			cout << "can't open file " << filename << endl;
+			Close();
+			return false;
+		}
+		mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, (DWORD)((unsigned long long)size >> 32), (DWORD)size, NULL);
+		base = mapping == NULL ? NULL : (char*)MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0);
+#else
+		int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0)
+		{
+			cout << "can't open file " << filename << endl;
+			return false;
+		}
+		// allocate the blocks up front, so that writing through the map can't fail on a full disk
+		bool allocated = ftruncate(fd, size) == 0;
+#if defined(__linux__)
+		allocated = allocated && posix_fallocate(fd, 0, size) == 0;
+#endif
+		void* p = allocated ? mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+		close(fd);
+		base = p == MAP_FAILED ? NULL : (char*)p;
+#endif
+		if (base == NULL)
+		{
+			cout << "fail to save binary to " << filename << endl;
+			Close();
+			return false;
+		}
+		rows = rows_;
+		cols = cols_;
+		((unsigned int*)base)[0] = rows;
+		((unsigned int*)base)[1] = cols;
+		return true;
+	}
+
+	void Close()
+	{
+#ifdef _WIN32
+		if (base != NULL) UnmapViewOfFile(base);
+		if (mapping != NULL) CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+		mapping = NULL;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (base != NULL) munmap(base, size);
+#endif
+		base = NULL;
+		size = 0;
+		rows = cols = 0;
+	}
+
+	const ValueType* data() const { return (const ValueType*)(base + 2 * sizeof(unsigned int)); }
+	ValueType* mutable_data() { return (ValueType*)(base + 2 * sizeof(unsigned int)); }
+	const ValueType* row(size_t r) const { return data() + r * cols; }
+
+	unsigned int rows, cols;
+
+private:
+	MappedBinary(const MappedBinary&);
+	MappedBinary& operator=(const MappedBinary&);
+
+	char* base;
+	size_t size;
+#ifdef _WIN32
+	HANDLE file, mapping;
+#endif
+};
+
+// read only view of a rows/cols binary file, valid as long as view lives
+template<class ValueType>
+bool LoadBinary(const char* filename, MappedBinary<ValueType>& view, unsigned int& rows, unsigned int& cols)
+{
+	if (!view.Open(filename))
+		return false;
+	rows = view.rows;
+	cols = view.cols;
+	return true;
+}
+
+// write a rows/cols binary file through a mapped region of its final size
+template<class ValueType>
+bool SaveBinary(const char* filename, const ValueType* pBuffer, unsigned int rows, unsigned int cols)
+{
+	MappedBinary<ValueType> file;
+	if (!file.Create(filename, rows, cols))
+		return false;
+	memcpy(file.mutable_data(), pBuffer, (size_t)rows * cols * sizeof(ValueType));
+	return true;
+}
+
+// reads a rows/cols binary file batch_rows rows at a time, while a background thread reads up to queue batches ahead
+// memory stays at (queue + 1) batches whatever the size of the file
+//	BinaryRowReader<float> reader;
+//	const float* batch; unsigned int count;
+//	if (reader.Open(filename, 4096))
+//		while (reader.Next(batch, count)) ... // count rows of reader.cols values, valid until the next call
+template<class ValueType>
+class BinaryRowReader
+{
+public:
+	BinaryRowReader() : rows(0), cols(0) {}
+	~BinaryRowReader() { Close(); }
+
+	bool Open(const char* filename, unsigned int batch_rows_, unsigned int queue = 2)
+	{
+		Close();
+		in.clear();
+		in.open(filename, ios::in | ios::binary);
+		if (!in)
+		{
+			cout << "can't open file " << filename << endl;
+			return false;
+		}
+		in.read((char*)&rows, sizeof(unsigned int));
+		in.read((char*)&cols, sizeof(unsigned int));
+		if (!in)
+		{
+			cout << "fail to load binary row and col number from " << filename << endl;
+			in.close();
+			return false;
+		}
+		name = filename;
+		batch_rows = batch_rows_ > 0 ? batch_rows_ : 1;
+		batch_num = (rows + batch_rows - 1) / batch_rows;
+		buffer.assign(queue + 1, vector<ValueType>((size_t)batch_rows * cols));
+		produced = released = taken = 0;
+		stop = error = false;
+		worker = thread(&BinaryRowReader::ReadAhead, this);
+		return true;
+	}
+
+	// next batch of count rows, false at the end of the file or if it can't be read
+	bool Next(const ValueType*& batch, unsigned int& count)
+	{
+		unique_lock<mutex> lock(state);
+		if (taken > released)
+		{
+			released++; // the batch returned last time can be refilled
+			changed.notify_all();
+		}
+		if (taken == batch_num)
+			return false;
+		changed.wait(lock, [this] { return produced > taken || error; });
+		if (produced == taken)
+		{
+			cout << "fail to load binary from " << name << endl;
+			return false;
+		}
+		batch = buffer[taken % buffer.size()].empty() ? NULL : &buffer[taken % buffer.size()][0];
+		count = taken + 1 < batch_num ? batch_rows : rows - taken * batch_rows;
+		taken++;
+		return true;
+	}
+
+	void Close()
+	{
+		if (worker.joinable())
+		{
+			{
+				lock_guard<mutex> lock(state);
+				stop = true;
+			}
+			changed.notify_all();
+			worker.join();
+		}
+		if (in.is_open())
+			in.close();
+	}
+
+	unsigned int rows, cols;
+
+private:
+	BinaryRowReader(const BinaryRowReader&);
+	BinaryRowReader& operator=(const BinaryRowReader&);
+
+	void ReadAhead()
+	{
+		for (unsigned int b = 0; b < batch_num; b++)
+		{
+			{
+				unique_lock<mutex> lock(state);
+				changed.wait(lock, [this] { return produced - released < buffer.size() || stop; });
+				if (stop)
+					return;
+			}
+			unsigned int count = b + 1 < batch_num ? batch_rows : rows - b * batch_rows;
+			if (cols > 0) // rows of 0 values have no buffer to read into
+				in.read((char*)&buffer[b % buffer.size()][0], sizeof(ValueType) * count * cols);
+			lock_guard<mutex> lock(state);
+			if (!in)
+				error = true;
+			else
+				produced++;
+			changed.notify_all();
+			if (error)
+				return;
+		}
+	}
+
+	ifstream in;
+	string name;
+	unsigned int batch_rows, batch_num;
+	vector<vector<ValueType> > buffer; // batch b is read into buffer[b % buffer.size()]
+	unsigned int produced, released, taken; // batches read by ReadAhead, given back by Next, returned by Next
+	bool stop, error;
+	mutex state;
+	condition_variable changed;
+	thread worker;
+};
+
 #include <string>
 #include <vector>
 
@@ -18,7 +18,7 @@
 
 #include <math.h>
 
-#ifndef __CUDACC__
+#if !defined(__CUDACC__) && defined(_WIN32)
 #include <windows.h>
 #endif
 
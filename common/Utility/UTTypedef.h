@@ -4,12 +4,20 @@
 typedef unsigned char       UInt8 ;
 typedef unsigned short      UInt16;
 typedef unsigned int        UInt32;
+#ifdef _MSC_VER
 typedef unsigned __int64    UInt64;
+#else
+typedef unsigned long long  UInt64;
+#endif
 
 // signed integers
 typedef signed char       Int8 ;
 typedef signed short      Int16;
 typedef signed int        Int32;
+#ifdef _MSC_VER
 typedef signed __int64    Int64;
+#else
+typedef signed long long  Int64;
+#endif
 
 typedef Int32    givMInt;
@@ -2,8 +2,31 @@
 
 // iostream based binary I/O support, in a similar manner as using operator << and >>
 #include <iostream>
+#include <type_traits>
+#include <utility>
+#include <vector>
 using namespace std;
 
+// header of write_array / read_array, followed by count items of scalar_num scalars of scalar_size bytes
+// byte_order is 0x01020304 as the writer stored it, read_array swaps the bytes if it reads 0x04030201
+struct binary_array_header
+{
+	char magic[4];				// "NUMA"
+	unsigned int byte_order;
+	unsigned int version;
+	unsigned int scalar_size;	// sizeof(Type::value_type), or sizeof(Type) for scalars
+	unsigned int scalar_num;	// scalars per item, e.g. 16 for Matrix4
+	unsigned int count;			// items
+
+	enum { ByteOrder = 0x01020304, Version = 1 };
+};
+
+// scalar of an item of write_array / read_array: Type::value_type, or Type itself for int, float, double, ...
+template<class Type, bool = is_arithmetic<Type>::value>
+struct binary_array_scalar { typedef typename Type::value_type type; };
+template<class Type>
+struct binary_array_scalar<Type, true> { typedef Type type; };
+
 class ostream_binary
 {
 public:
@@ -32,6 +55,26 @@ public:
 		os.write((char*)pV, sizeof(Type)*len);
 		return *this;
 	}
+
+	// count items (Matrix4, Vector4, Vector3, ... : a plain array of Type::value_type, or scalars) in one write after a binary_array_header
+	template<class Type>
+	ostream_binary& write_array(const Type* pV, const unsigned int count)
+	{
+		typedef typename binary_array_scalar<Type>::type value_type;
+		static_assert(sizeof(Type) % sizeof(value_type) == 0, "write_array needs items made of value_type only");
+		binary_array_header h = { { 'N', 'U', 'M', 'A' }, binary_array_header::ByteOrder, binary_array_header::Version,
+			sizeof(value_type), sizeof(Type) / sizeof(value_type), count };
+		os.write((char*)&h, sizeof(h));
+		if (count > 0)
+			os.write((char*)pV, (streamsize)sizeof(Type) * count);
+		return *this;
+	}
+
+	template<class Type>
+	ostream_binary& write_array(const vector<Type>& data)
+	{
+		return write_array(data.empty() ? (const Type*)0 : &data[0], (unsigned int)data.size());
+	}
 };
 
 class istream_binary
@@ -67,6 +110,46 @@ public:
 		is.read((char*)pV, sizeof(Type)*len);
 		return *this;
 	}
+
+	// items written by write_array, in one read; fails (operator!) if the header doesn't match Type
+	template<class Type>
+	istream_binary& read_array(vector<Type>& data)
+	{
+		typedef typename binary_array_scalar<Type>::type value_type;
+		binary_array_header h;
+		is.read((char*)&h, sizeof(h));
+		if (!is)
+			return *this;
+		bool swap = h.byte_order != binary_array_header::ByteOrder;
+		if (swap)
+		{
+			swap_bytes((char*)&h.byte_order, sizeof(unsigned int), 5);
+			if (h.byte_order != binary_array_header::ByteOrder)
+				swap = false, h.version = 0; // neither byte order
+		}
+		if (h.magic[0] != 'N' || h.magic[1] != 'U' || h.magic[2] != 'M' || h.magic[3] != 'A' || h.version != binary_array_header::Version
+			|| h.scalar_size != sizeof(value_type) || h.scalar_num * sizeof(value_type) != sizeof(Type))
+		{
+			is.setstate(ios::failbit);
+			return *this;
+		}
+		data.resize(h.count);
+		if (h.count > 0)
+		{
+			is.read((char*)&data[0], (streamsize)sizeof(Type) * h.count);
+			if (swap)
+				swap_bytes((char*)&data[0], sizeof(value_type), (size_t)h.scalar_num * h.count);
+		}
+		return *this;
+	}
+
+private:
+	static void swap_bytes(char* p, const size_t size, const size_t num)
+	{
+		for (size_t n = 0; n < num; n++, p += size)
+			for (size_t i = 0; i < size / 2; i++)
+				std::swap(p[i], p[size - 1 - i]);
+	}
 };
 
 void test_binary_iostream();
\ No newline at end of file
@@ -50,16 +50,12 @@ namespace numeric
 
 		inline friend ostream_binary & operator<< (ostream_binary& out, const Matrix4<C>& m)
 		{
-			for(int n = 0; n < 16; n++)	
-				out << m.v[n];
-			return out;
+			return out.write(&m.v[0], 16);
 		}
 
 		inline friend istream_binary & operator>> (istream_binary& in, Matrix4<C>& m)
 		{
-			for(int n = 0; n < 16; n++)	
-				in >> m.v[n];
-			return in;
+			return in.read(&m.v[0], 16);
 		}
 
 		inline friend istream & operator>> (istream & in, Matrix4<C>& m)
@@ -153,21 +149,54 @@ namespace numeric
 		// Post mult this matrix by a homogeneous rotation matrix along X axis
 		Matrix4& RMult_RotateX(const value_type theta)
 		{
-			*this = (*this) * Matrix4(rot_x, theta, false);
-			return *this;
+			return RMult_RotateX(cos(theta), sin(theta));
 		}
 
 		// Post mult this matrix by a homogeneous rotation matrix along Y axis
 		Matrix4& RMult_RotateY(const value_type theta)
 		{
-			*this = (*this) * Matrix4(rot_y, theta, false);
-			return *this;
+			return RMult_RotateY(cos(theta), sin(theta));
 		}
 
 		// Post mult this matrix by a homogeneous rotation matrix along Z axis
 		Matrix4& RMult_RotateZ(const value_type theta)
 		{
-			*this = (*this) * Matrix4(rot_z, theta, false);
+			return RMult_RotateZ(cos(theta), sin(theta));
+		}
+
+		// Same as above with cos(theta) and sin(theta) given, only columns 1 and 2 change
+		Matrix4& RMult_RotateX(const value_type c, const value_type s)
+		{
+			for (int n = 0; n < 16; n += 4)
+			{
+				C m1 = v[n + 1], m2 = v[n + 2];
+				v[n + 1] = m1 * c + m2 * s;
+				v[n + 2] = m2 * c - m1 * s;
+			}
+			return *this;
+		}
+
+		// only columns 0 and 2 change
+		Matrix4& RMult_RotateY(const value_type c, const value_type s)
+		{
+			for (int n = 0; n < 16; n += 4)
+			{
+				C m0 = v[n], m2 = v[n + 2];
+				v[n] = m0 * c + m2 * s;
+				v[n + 2] = m2 * c - m0 * s;
+			}
+			return *this;
+		}
+
+		// only columns 0 and 1 change
+		Matrix4& RMult_RotateZ(const value_type c, const value_type s)
+		{
+			for (int n = 0; n < 16; n += 4)
+			{
+				C m0 = v[n], m1 = v[n + 1];
+				v[n] = m0 * c + m1 * s;
+				v[n + 1] = m1 * c - m0 * s;
+			}
 			return *this;
 		}
 
@@ -177,14 +206,46 @@ namespace numeric
 			return *this;
 		}
 
+		// Post mult this matrix by a homogeneous translation along X, Y or Z axis, only column 3 changes
+		Matrix4& RMult_TranslateX(const value_type delta)
+		{
+			v[3] += v[0] * delta;	v[7] += v[4] * delta;	v[11] += v[8] * delta;	v[15] += v[12] * delta;
+			return *this;
+		}
+
+		Matrix4& RMult_TranslateY(const value_type delta)
+		{
+			v[3] += v[1] * delta;	v[7] += v[5] * delta;	v[11] += v[9] * delta;	v[15] += v[13] * delta;
+			return *this;
+		}
+
+		Matrix4& RMult_TranslateZ(const value_type delta)
+		{
+			v[3] += v[2] * delta;	v[7] += v[6] * delta;	v[11] += v[10] * delta;	v[15] += v[14] * delta;
+			return *this;
+		}
+
 		Matrix4& RMult_TranslateXYZ(const value_type xdelta, const value_type ydelta, const value_type zdelta)
 		{
-			*this = (*this) * Matrix4f(matrix_operation::trans_x, xdelta, false);
-			*this = (*this) * Matrix4f(matrix_operation::trans_y, ydelta, false);
-			*this = (*this) * Matrix4f(matrix_operation::trans_z, zdelta, false);
+			(*this).RMult_TranslateX(xdelta).RMult_TranslateY(ydelta).RMult_TranslateZ(zdelta);
 			return *this;
 		}
 
+		// Same as *this = (*this) * Matrix4(opt, value, false), without forming the 4x4 matrix
+		Matrix4& RMult(const matrix_operation &opt, const value_type value)
+		{
+			switch (opt)
+			{
+			case rot_x:		return RMult_RotateX(value);
+			case rot_y:		return RMult_RotateY(value);
+			case rot_z:		return RMult_RotateZ(value);
+			case trans_x:	return RMult_TranslateX(value);
+			case trans_y:	return RMult_TranslateY(value);
+			case trans_z:	return RMult_TranslateZ(value);
+			default:		return (*this) *= Matrix4(opt, value, false);
+			}
+		}
+
 
 		// TODO: need to explicitly define copy constructor and assignment operator for raw memory?
 #ifdef USE_RAW_MEM
@@ -216,9 +277,9 @@ namespace numeric
 			v = vector<C>(16);
 #endif
 
-			v[0] = p0.x[0];	v[1] = p0.x[1];	v[2] = p0.x[2];	 v[3] = 1;
-			v[4] = p1.x[0];	v[5] = p1.x[1];	v[6] = p1.x[2];	 v[7] = 1;
-			v[8] = p2.x[0];	v[9] = p2.x[1];	v[10] = p2.x[2]; v[11] = 1;
+			v[0] = p0.x;	v[1] = p0.y;	v[2] = p0.z;	 v[3] = 1;
+			v[4] = p1.x;	v[5] = p1.y;	v[6] = p1.z;	 v[7] = 1;
+			v[8] = p2.x;	v[9] = p2.y;	v[10] = p2.z; v[11] = 1;
 			v[12] = 1;		v[13] = 1;		v[14] = 1;		 v[15] = 1;
 		}
 
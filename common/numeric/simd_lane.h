@@ -0,0 +1,93 @@
+#pragma once
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace numeric
+{
+	// A pack of values handled by one SIMD instruction, used to lay a batch out as structure of arrays (one lane per sample)
+	// width is 8 (double) / 16 (float) with AVX-512, 4 / 8 with AVX2 and 1 otherwise
+	// load/store take unaligned pointers to width consecutive values
+	template <class C> struct Lane;
+
+	template <>
+	struct Lane<double>
+	{
+#if defined(__AVX512F__)
+		enum { width = 8 };
+		__m512d v;
+		Lane() {}
+		Lane(__m512d _v) : v(_v) {}
+		explicit Lane(const double value) : v(_mm512_set1_pd(value)) {}
+		static Lane load(const double* p)	{ return Lane(_mm512_loadu_pd(p)); }
+		void store(double* p) const			{ _mm512_storeu_pd(p, v); }
+		friend Lane operator+ (const Lane& a, const Lane& b)	{ return Lane(_mm512_add_pd(a.v, b.v)); }
+		friend Lane operator- (const Lane& a, const Lane& b)	{ return Lane(_mm512_sub_pd(a.v, b.v)); }
+		friend Lane operator* (const Lane& a, const Lane& b)	{ return Lane(_mm512_mul_pd(a.v, b.v)); }
+#elif defined(__AVX2__)
+		enum { width = 4 };
+		__m256d v;
+		Lane() {}
+		Lane(__m256d _v) : v(_v) {}
+		explicit Lane(const double value) : v(_mm256_set1_pd(value)) {}
+		static Lane load(const double* p)	{ return Lane(_mm256_loadu_pd(p)); }
+		void store(double* p) const			{ _mm256_storeu_pd(p, v); }
+		friend Lane operator+ (const Lane& a, const Lane& b)	{ return Lane(_mm256_add_pd(a.v, b.v)); }
+		friend Lane operator- (const Lane& a, const Lane& b)	{ return Lane(_mm256_sub_pd(a.v, b.v)); }
+		friend Lane operator* (const Lane& a, const Lane& b)	{ return Lane(_mm256_mul_pd(a.v, b.v)); }
+#else
+		enum { width = 1 };
+		double v;
+		Lane() {}
+		explicit Lane(const double value) : v(value) {}
+		static Lane load(const double* p)	{ return Lane(*p); }
+		void store(double* p) const			{ *p = v; }
+		friend Lane operator+ (const Lane& a, const Lane& b)	{ return Lane(a.v + b.v); }
+		friend Lane operator- (const Lane& a, const Lane& b)	{ return Lane(a.v - b.v); }
+		friend Lane operator* (const Lane& a, const Lane& b)	{ return Lane(a.v * b.v); }
+#endif
+		Lane& operator+= (const Lane& r)	{ return (*this) = (*this) + r; }
+		Lane& operator-= (const Lane& r)	{ return (*this) = (*this) - r; }
+	};
+
+	template <>
+	struct Lane<float>
+	{
+#if defined(__AVX512F__)
+		enum { width = 16 };
+		__m512 v;
+		Lane() {}
+		Lane(__m512 _v) : v(_v) {}
+		explicit Lane(const float value) : v(_mm512_set1_ps(value)) {}
+		static Lane load(const float* p)	{ return Lane(_mm512_loadu_ps(p)); }
+		void store(float* p) const			{ _mm512_storeu_ps(p, v); }
+		friend Lane operator+ (const Lane& a, const Lane& b)	{ return Lane(_mm512_add_ps(a.v, b.v)); }
+		friend Lane operator- (const Lane& a, const Lane& b)	{ return Lane(_mm512_sub_ps(a.v, b.v)); }
+		friend Lane operator* (const Lane& a, const Lane& b)	{ return Lane(_mm512_mul_ps(a.v, b.v)); }
+#elif defined(__AVX2__)
+		enum { width = 8 };
+		__m256 v;
+		Lane() {}
+		Lane(__m256 _v) : v(_v) {}
+		explicit Lane(const float value) : v(_mm256_set1_ps(value)) {}
+		static Lane load(const float* p)	{ return Lane(_mm256_loadu_ps(p)); }
+		void store(float* p) const			{ _mm256_storeu_ps(p, v); }
+		friend Lane operator+ (const Lane& a, const Lane& b)	{ return Lane(_mm256_add_ps(a.v, b.v)); }
+		friend Lane operator- (const Lane& a, const Lane& b)	{ return Lane(_mm256_sub_ps(a.v, b.v)); }
+		friend Lane operator* (const Lane& a, const Lane& b)	{ return Lane(_mm256_mul_ps(a.v, b.v)); }
+#else
+		enum { width = 1 };
+		float v;
+		Lane() {}
+		explicit Lane(const float value) : v(value) {}
+		static Lane load(const float* p)	{ return Lane(*p); }
+		void store(float* p) const			{ *p = v; }
+		friend Lane operator+ (const Lane& a, const Lane& b)	{ return Lane(a.v + b.v); }
+		friend Lane operator- (const Lane& a, const Lane& b)	{ return Lane(a.v - b.v); }
+		friend Lane operator* (const Lane& a, const Lane& b)	{ return Lane(a.v * b.v); }
+#endif
+		Lane& operator+= (const Lane& r)	{ return (*this) = (*this) + r; }
+		Lane& operator-= (const Lane& r)	{ return (*this) = (*this) - r; }
+	};
+}
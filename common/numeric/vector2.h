@@ -4,7 +4,7 @@
 #include <vector>
 #include <assert.h>
 
-#include <Utility\iostream_binary.h>
+#include <Utility/iostream_binary.h>
 
 namespace numeric
 {
@@ -4,7 +4,7 @@
 #include <vector>
 #include <assert.h>
 
-#include <Utility\iostream_binary.h>
+#include <Utility/iostream_binary.h>
 
 namespace numeric
 {
@@ -29,6 +29,7 @@ namespace numeric
 			}
 		inline explicit Vector4(const C & value)  { x[0] = x[1] = x[2] = x[3] = value; }
 		inline Vector4(const C & _x, const C & _y, const C & _z, const C & _w) { x[0] = _x; x[1] = _y; x[2] = _z; x[3] = _w; }
+		inline Vector4(const Vector4<C> & r) { x[0] = r.x[0]; x[1] = r.x[1]; x[2] = r.x[2]; x[3] = r.x[3]; }
 
 		// unary operator
 		inline Vector4<C> operator-() const { return Vector4<C>(-x[0], -x[1], -x[2], -x[3]); }
@@ -77,8 +78,7 @@ namespace numeric
 
 		inline friend ostream_binary& operator<< (ostream_binary& out, const Vector4<C> & r) 
 		{	
-			out << r.x[0] << r.x[1] << r.x[2] << r.x[3];
-			return out;
+			return out.write(r.x, 4);
 		}
 
 		template<class IStreamType>
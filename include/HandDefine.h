@@ -100,3 +100,31 @@ const int prev_seq[JointNum] =    { -1, palm_center, palm_center, palm_center, t
 									ring_finger_mcp, ring_finger_base, ring_finger_pip_first, ring_finger_pip_second, ring_finger_dip,
 									middle_finger_mcp, middle_finger_base, middle_finger_pip_first, middle_finger_pip_second, middle_finger_dip,
 									index_finger_mcp, index_finger_base, index_finger_pip_first, index_finger_pip_second, index_finger_dip };
+
+//DoFs 6-14 and 19-30 that keep the seven palm joints in place (their values always come from InitialParameters.in)
+#define HAND_MODEL_FIXED_DOF(d) (((d) >= wrist_left_const_rot_x && (d) <= thumb_mcp_const_rot_z) || ((d) >= little_finger_mcp_const_rot_x && (d) <= index_finger_mcp_const_rot_z))
+
+//Compile-time form of the kinematic chain, in the order of "forward_seq" (the program HandKinematics::CompileProgram builds at runtime)
+//The fixed rotations of wrist left, wrist middle, thumb MCP and finger MCPs are folded into their Const_Matr
+//BEGIN(joint, parent) starts a joint from the transformation of its parent(-1 : identity), 
+//STEP(opt, id) right multiplies one matrix(id is the DoF, or the const matrix slot for Const_Matr), END(joint) finishes the joint
+#define HAND_MODEL_FINGER_MCP(BEGIN, STEP, END, k) \
+	BEGIN(finger_mcp_start + k, palm_center) STEP(Const_Matr, finger_mcp_start + k) END(finger_mcp_start + k)
+
+#define HAND_MODEL_FINGER(BEGIN, STEP, END, k) \
+	BEGIN(finger_base_start + EachFingerBoneNum * k, finger_mcp_start + k) STEP(rot_z, finger_base_rot_z_start + EachFingerDoFNum * k) STEP(rot_x, finger_base_rot_x_start + EachFingerDoFNum * k) STEP(Const_Matr, finger_base_start + EachFingerBoneNum * k) END(finger_base_start + EachFingerBoneNum * k) \
+	BEGIN(finger_pip_first_start + EachFingerBoneNum * k, finger_base_start + EachFingerBoneNum * k) STEP(rot_x, finger_pip_rot_x_start + EachFingerDoFNum * k) STEP(Const_Matr, finger_pip_first_start + EachFingerBoneNum * k) END(finger_pip_first_start + EachFingerBoneNum * k) \
+	BEGIN(finger_pip_second_start + EachFingerBoneNum * k, finger_pip_first_start + EachFingerBoneNum * k) STEP(Const_Matr, finger_pip_second_start + EachFingerBoneNum * k) END(finger_pip_second_start + EachFingerBoneNum * k) \
+	BEGIN(finger_dip_start + EachFingerBoneNum * k, finger_pip_second_start + EachFingerBoneNum * k) STEP(rot_x, finger_dip_rot_x_start + EachFingerDoFNum * k) STEP(Const_Matr, finger_dip_start + EachFingerBoneNum * k) END(finger_dip_start + EachFingerBoneNum * k) \
+	BEGIN(finger_tip_start + EachFingerBoneNum * k, finger_dip_start + EachFingerBoneNum * k) STEP(Const_Matr, finger_tip_start + EachFingerBoneNum * k) END(finger_tip_start + EachFingerBoneNum * k)
+
+#define HAND_MODEL_CHAIN(BEGIN, STEP, END) \
+	BEGIN(palm_center, -1) STEP(trans_x, global_trans_x) STEP(trans_y, global_trans_y) STEP(trans_z, global_trans_z) STEP(rot_z, global_rot_z) STEP(rot_x, global_rot_x) STEP(rot_y, global_rot_y) END(palm_center) \
+	BEGIN(wrist_left, palm_center) STEP(Const_Matr, wrist_left) END(wrist_left) \
+	BEGIN(wrist_middle, palm_center) STEP(Const_Matr, wrist_middle) END(wrist_middle) \
+	BEGIN(thumb_mcp, palm_center) STEP(Const_Matr, thumb_mcp) END(thumb_mcp) \
+	BEGIN(thumb_pip, thumb_mcp) STEP(rot_z, thumb_pip_rot_z) STEP(rot_y, thumb_pip_rot_y) STEP(Const_Matr, thumb_pip) END(thumb_pip) \
+	BEGIN(thumb_dip, thumb_pip) STEP(rot_z, thumb_dip_rot_z) STEP(Const_Matr, thumb_dip) END(thumb_dip) \
+	BEGIN(thumb_tip, thumb_dip) STEP(rot_z, thumb_tip_rot_z) STEP(Const_Matr, thumb_tip) END(thumb_tip) \
+	HAND_MODEL_FINGER_MCP(BEGIN, STEP, END, 0) HAND_MODEL_FINGER_MCP(BEGIN, STEP, END, 1) HAND_MODEL_FINGER_MCP(BEGIN, STEP, END, 2) HAND_MODEL_FINGER_MCP(BEGIN, STEP, END, 3) \
+	HAND_MODEL_FINGER(BEGIN, STEP, END, 0) HAND_MODEL_FINGER(BEGIN, STEP, END, 1) HAND_MODEL_FINGER(BEGIN, STEP, END, 2) HAND_MODEL_FINGER(BEGIN, STEP, END, 3)
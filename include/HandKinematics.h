@@ -0,0 +1,153 @@
+#pragma once
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "numeric/matrix4.h"
+#include "numeric/vector4.h"
+#include "numeric/simd_lane.h"
+#include "HandDefine.h"
+#include "HandModelConfig.h"
+
+//Kinematic core of the hand model (forward kinematics and its gradient), free of Caffe.
+//Poses and joints are plain arrays: pose t is dof + t * dof_stride (ParamNum DoFs),
+//its joints are joint + t * joint_stride (JointNum * 3 coordinates in the order of HandDefine.h).
+
+//#define HAND_MODEL_JACOBIAN_BACKWARD	// fill the whole Jacobian per sample in Backward (reference) instead of the reverse-mode sweep
+//#define HAND_MODEL_SCREW_JACOBIAN	// Jacobian columns in closed form, axis x (joint - axis origin) for rotations and the axis for translations, instead of derivative matrices (faster, but no longer independent of the reverse-mode sweep it validates)
+//#define HAND_MODEL_STRICT_DOUBLE	// run the kinematics in double also for float poses (otherwise float runs in float, twice the SIMD lanes)
+using namespace numeric;
+namespace hand_model
+{
+	typedef Matrix4<double> Matr;
+	typedef Vector4<double> Vec;
+
+	//One matrix of the kinematic chain in the compiled program
+	struct KinematicStep
+	{
+		matrix_operation opt; //rot_x, rot_y, rot_z, trans_x, trans_y, trans_z or Const_Matr
+		int param_id;         //DoF index, or const_matr slot if opt is Const_Matr
+	};
+
+	//Steps [begin, end) of the program turn prev_mat[parent_id] into prev_mat[joint_id]
+	struct KinematicJoint
+	{
+		int joint_id;
+		int parent_id;        //-1 for palm center (starts from identity)
+		int begin, end;
+	};
+
+	enum hand_model_layout
+	{
+		FrameSize = 12 //top 3 rows of a rigid transformation (the last row is always 0 0 0 1)
+	};
+
+	//Precision of the kinematics of HandKinematics<Dtype>
+	template <typename Dtype> struct hand_model_real
+	{
+	#ifdef HAND_MODEL_STRICT_DOUBLE
+		typedef double type;
+	#else
+		typedef Dtype type;
+	#endif
+	};
+
+	//Working state of HandKinematics::Backward, one copy per thread so that samples of a batch run in parallel.
+	//Allocated by Reshape (and again only if the thread count grows), so Backward itself never allocates
+	template <typename Real>
+	struct HandModelScratch
+	{
+		Vec Jacobian[JointNum][ParamNum]; //partial derivative of joint with respect to parameter (only joint_dof entries are valid)
+		Matr step_left[ParamNum * 3]; //frame before each step of the Homo_mat suffixes along the tree (less than ParamNum * 3 steps)
+		Matr joint_mat[JointNum];     //frame of each joint
+		Real joint_diff[JointNum][3][Lane<Real>::width]; //joint_diff gathered into lanes
+		Real frame_diff[FrameSize][Lane<Real>::width];   //frame_diff of one joint gathered into lanes
+		Real grad[ParamNum][Lane<Real>::width];     //dof_diff of a group before it is scattered back to samples
+	};
+
+	template <typename Dtype>
+	class HandKinematics
+	{
+	  public:
+		HandKinematics() : group_num(0), keep_step_frame(true), cache_dof(NULL), cache_batch(0), last_batch(0) {}
+
+		//Builds the chain from the shared configuration of dir (HandModelConfig::Get), or from config
+		bool LoadConfiguration(const char *dir);
+		bool LoadConfiguration(std::shared_ptr<const HandModelConfig> config);
+		//Sizes the caches for batches of up to batSize poses, keeps them (and the state of ForwardIncremental) if the size doesn't change
+		void Reshape(int batSize);
+		//Forward only (e.g. converting poses): Forward doesn't keep the step frames Backward needs, program.size() * FrameSize
+		//values per pose. Backward turns them back on (and runs Forward again)
+		void SetForwardOnly(bool forward_only);
+		//If frame is not NULL, frame + t * frame_stride also gets the JointNum rigid transformations of pose t (prev_mat, top 3 rows of each, row major)
+		void Forward(int batSize, const Dtype *dof, int dof_stride, Dtype *joint, int joint_stride, Dtype *frame = NULL, int frame_stride = 0);
+		//Forward for tracking: if the previous call was ForwardIncremental on batSize poses as well, only the joints
+		//moved by the DoFs that changed since then are recomputed. Returns the number of joints recomputed (per group of LaneWidth poses)
+		int ForwardIncremental(int batSize, const Dtype *dof, int dof_stride, Dtype *joint, int joint_stride, Dtype *frame = NULL, int frame_stride = 0);
+		//dof_diff = joint_diff * d joint / d dof, reuses the caches of Forward if it ran on the same dof buffer and batSize and the
+		//poses in it still have the same values (they are compared, a buffer changed in place since Forward runs Forward again)
+		//If frame_diff is not NULL (laid out like frame of Forward), frame_diff * d frame / d dof is added
+		void Backward(int batSize, const Dtype *dof, int dof_stride, const Dtype *joint_diff, int joint_diff_stride, Dtype *dof_diff, int dof_diff_stride,
+			const Dtype *frame_diff = NULL, int frame_diff_stride = 0);
+
+		//Double precision reference for one pose: the product of the whole Homo_mat, and the Jacobian (both from Homo_mat and const_matr, independent of program)
+		//(several threads of a parallel region of the caller may share one instance for ReferenceGradient once a call outside the region sized it for them)
+		void ReferenceJoint(const Dtype *dof, double *joint);
+		void ReferenceGradient(const Dtype *dof, const Dtype *joint_diff, double *grad);
+
+	  private:
+		typedef typename hand_model_real<Dtype>::type Real;
+		enum { LaneWidth = Lane<Real>::width }; //samples evaluated together, one per SIMD lane
+
+		//1. Related to parameter (isFixed, initparam) and shape parameters (bonelen), shared with every other instance
+		std::shared_ptr<const HandModelConfig> config;
+
+		//2. Related to transformation
+		Matr const_matr[ConstMatrNum];
+		Matr chain_matr[ConstMatrNum]; //const_matr with the fixed DoFs right before it folded in, used by program
+		std::vector<std::pair<matrix_operation, int> > Homo_mat[JointNum]; //Homogenous matrices (represent transformation for each joint)
+		std::vector<KinematicStep> program; //Homo_mat flattened along forward_seq, each step appears only once
+		KinematicJoint program_joint[JointNum]; //in the order of "forward_seq"
+		std::vector<int> joint_dof[JointNum]; //free DoFs in Homo_mat[joint], the only nonzero entries of its Jacobian
+		unsigned long long joint_dof_mask[JointNum]; //joint_dof as bits (ParamNum < 64)
+		std::vector<int> joint_subtree[JointNum]; //the joint and all joints below it
+		bool use_chain; //program agrees with HAND_MODEL_CHAIN (config->isFixed with HAND_MODEL_FIXED_DOF), so the unrolled chain is used
+
+		//3. Related to joint locations, kept by Forward for Backward of the same batch
+		//The batch is split in group_num groups of LaneWidth samples, and every value below is stored as [group]...[lane] (structure of arrays)
+		int group_num;
+		std::vector<Real> dof_value;  //[group][ParamNum][lane] GetParam of every DoF
+		std::vector<Real> dof_cos;    //[group][ParamNum][lane] cos of dof_value (only used for rotations)
+		std::vector<Real> dof_sin;    //[group][ParamNum][lane]
+		std::vector<Real> prev_mat;   //[group][JointNum][FrameSize][lane] prev_mat * resttransformation, joint location is its translation
+		std::vector<Real> step_frame; //[group][program.size()][FrameSize][lane] cumulative transformation before each step
+		bool keep_step_frame;         //step_frame is allocated and filled by Forward (SetForwardOnly)
+		const Dtype *cache_dof; //dof the caches above were computed from (NULL if they are stale), see CachedDoF for its values
+		int cache_batch;
+		std::vector<Dtype> last_dof; //[sample][ParamNum] dof of the caches above, kept by ForwardIncremental
+		int last_batch;              //batSize of last_dof, 0 once anything else overwrote the caches
+
+		//4. Related to back propagated gradient (one HandModelScratch per thread)
+		std::vector<HandModelScratch<Real> > scratch;
+		void GrowScratch();
+		HandModelScratch<Real>& ThreadScratch();
+		void ReferenceGradient(const Dtype *dof, const Dtype *joint_diff, double *grad, HandModelScratch<Real> &s);
+
+		//5. Main functions
+		Matr GetMatrix(matrix_operation opt, int bottom_id, int param_id, bool is_gradient, const Dtype *bottom_data);
+		double GetParam(int bottom_id, int param_id, const Dtype *bottom_data);
+		void PrepareDoF(int batSize, const Dtype *dof, int dof_stride);
+		bool CachedDoF(int batSize, const Dtype *dof, int dof_stride);
+		void Forward(int group_id);
+		void ForwardJoint(int group_id, int i);
+		void CopyJoint(int group_id, int batSize, Dtype *joint, int joint_stride, Dtype *frame, int frame_stride);
+		void Jacobian(const Dtype *dof, HandModelScratch<Real> &s);
+		void BackwardAdjoint(int group_id, int batSize, const Dtype *joint_diff, int joint_diff_stride, Dtype *dof_diff, int dof_diff_stride,
+			const Dtype *frame_diff, int frame_diff_stride, HandModelScratch<Real> &s);
+		void SetupConstantMatrices();
+		void SetupTransformation();
+		void CompileProgram();
+		bool MatchChain();
+	};
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "HandDefine.h"
+
+//Configuration of the hand model (configuration/*.in), parsed once per process and shared read only
+//by every HandKinematics and DeepHandModelDofConstraintLossLayer:
+//  DofConstraintId.in          number of fixed DoFs, then their ids
+//  InitialParameters.in        ParamNum initial values (the value of fixed DoFs)
+//  BoneLength.in               BoneNum bone lengths
+//  DofConstraintLowerBound.in  ParamNum lower bounds (optional, only the constraint loss needs them)
+//  DofConstraintUpperBound.in  ParamNum upper bounds (optional)
+//If the directory has a bundle (BundleName, written by SaveBundle) that is newer than every text file,
+//it is read instead of them (the text files again if it can't be read). Get logs which of the two it loaded to std::cerr,
+//like every other message of the configuration, so that the standard output of the tools stays their own.
+namespace hand_model
+{
+	struct HandModelConfig
+	{
+		int isFixed[ParamNum];
+		double initparam[ParamNum]; //InitialRotationDegree
+		double bonelen[BoneNum];
+		bool has_bound;             //both bound files were found
+		float lower_bound[ParamNum];
+		float upper_bound[ParamNum];
+
+		//Shared configuration of dir, loaded on the first call for dir (any spelling of the same directory); NULL if it can't be loaded
+		static std::shared_ptr<const HandModelConfig> Get(const std::string &dir);
+
+		bool LoadText(const std::string &dir);
+		bool LoadBundle(const std::string &filename);
+		bool SaveBundle(const std::string &filename) const;
+
+		static const char *BundleName; //"HandModel.bundle"
+	};
+}
@@ -1,6 +1,7 @@
 #ifndef CAFFE_CUSTOM_LAYERS_HPP_
 #define CAFFE_CUSTOM_LAYERS_HPP_
 
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
@@ -10,12 +11,13 @@
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/layers/loss_layer.hpp"
-#include "caffe/numeric/Matrix.h"
-#include "caffe/numeric/Vector.h"
-#include "caffe/HandModel/HandDefine.h"
-using namespace numeric;
+#include "caffe/HandModel/HandKinematics.h"
+
+//#define HAND_MODEL_INCREMENTAL	// Forward_cpu only recomputes the joints moved by the DoFs that changed since the previous batch (tracking, where consecutive frames differ in a few finger DoFs)
+//#define HAND_MODEL_VALIDATE 64	// every 64th batch also runs the double precision reference (Homo_mat products and Jacobian) and logs how far top and bottom_diff deviate from it
 namespace caffe 
 {
+	using namespace hand_model;
 	
 	template <typename Dtype>
 	class DeepHandModelDofConstraintLossLayer : public LossLayer<Dtype> 
@@ -38,9 +40,8 @@ namespace caffe
 		  const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);	 
 		
 		const float PI = 3.1415926535897932384626;  
-		float DoFConstraintLowerBound[ParamNum];
-		float DoFConstraintUpperBound[ParamNum];
-		int isConstrained[ParamNum]; //whether to take account into the objective function
+		//DoF bounds, and isFixed : whether to take account into the objective function (fixed DoFs are not)
+		std::shared_ptr<const HandModelConfig> config;
 	};
 
 	template <typename Dtype>
@@ -48,7 +49,7 @@ namespace caffe
 	{
 	  public:
 		explicit DeepHandModelLayer(const LayerParameter& param)
-			: Layer<Dtype>(param) {}
+			: Layer<Dtype>(param), recomputed(0), validate_count(0), validate_batch(false) {}
 		virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
 			const vector<Blob<Dtype>*>& top);
 	
@@ -57,7 +58,9 @@ namespace caffe
 
 		virtual inline const char* type() const { return "DeepHandModel"; }
 		virtual inline int ExactNumBottomBlobs() const { return 1; }
-		virtual inline int ExactNumTopBlobs() const { return 1; }
+		//top[0] : joint locations (JointNum * 3), optional top[1] : rigid transformation of every joint (JointNum x 3 x 4), the diff of both is back propagated
+		virtual inline int MinTopBlobs() const { return 1; }
+		virtual inline int MaxTopBlobs() const { return 2; }
 		
 
 	  protected:
@@ -67,32 +70,13 @@ namespace caffe
 			const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);    
     
 	  private:      
-			
-
-			//1. Related to parameter:
-			int isFixed[ParamNum];
-			double initparam[ParamNum]; //InitialRotationDegree
-	
-			//2. Related to shape parameters(bone length)
-			double bonelen[BoneNum];
-
-			//3. Related to transformation
-			Matr const_matr[ConstMatrNum];
-			std::vector<std::pair<matrix_operation, int> > Homo_mat[JointNum]; //Homogenous matrices (represent transformation for each joint)
-			Matr prev_mat[JointNum];  //prev_mat * resttransformation
-
-			//4. Related to joint locations
-			Vec t_joint[JointNum];
+			//Kinematics of the hand model (HandKinematics.h), the layer only maps blobs to its pointer/stride interface
+			HandKinematics<Dtype> kinematics;
+			int recomputed; //joints (per group of poses) ForwardIncremental recomputed in the last batch (HAND_MODEL_INCREMENTAL)
 
-			//5. Related to back propagated gradient
-			Vec Jacobian[JointNum][ParamNum]; //partial derivative of joint with respect to parameter
-			
-			//6. Main functions
-			Matr GetMatrix(matrix_operation opt, int bottom_id, int image_id, int param_id, bool is_gradient, const Dtype *bottom_data);			
-			void Forward(Matr mat, int bottom_id, int image_id, int joint_id, int prev_size, const Dtype *bottom_data);
-			void Backward(int bottom_id, int image_id, int joint_id, const Dtype *bottom_data);			
-			void SetupConstantMatrices();
-			void SetupTransformation();		
+			//Related to validation of the fast path (HAND_MODEL_VALIDATE)
+			int validate_count;  //batches seen by Forward_cpu
+			bool validate_batch; //the current batch is compared with the reference in Forward_cpu and Backward_cpu
 	  };
 }  // namespace caffe
 
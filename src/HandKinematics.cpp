@@ -0,0 +1,782 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "numeric/sincos.h"
+#include "HandKinematics.h"
+
+namespace hand_model
+{
+	template <typename Dtype>
+	void HandKinematics<Dtype>::SetupConstantMatrices()
+	{	
+		//finger 5: thumb
+		const_matr[wrist_left] = Matr(trans_y, -config->bonelen[bone_palm_center_connect_wrist_left], false);		
+		const_matr[wrist_middle] = Matr(trans_y, -config->bonelen[bone_palm_center_connect_wrist_middle], false);	
+		const_matr[thumb_mcp] = Matr(trans_y, -config->bonelen[bone_palm_center_connect_thumb_mcp], false);
+		const_matr[thumb_pip] = Matr(trans_x, config->bonelen[bone_thumb_mcp_connect_pip], false);		
+		const_matr[thumb_dip] = Matr(trans_x, config->bonelen[bone_thumb_pip_connect_dip], false);
+		const_matr[thumb_tip] = Matr(trans_x, config->bonelen[bone_thumb_dip_connect_tip], false);
+		for (int k = 0; k < 4; k++) //finger 1 - finger 4 (little, ring, middle, index)
+		{
+			const_matr[finger_mcp_start + k] = Matr(trans_y, config->bonelen[bone_finger_mcp_connect_palm_center_start + k], false);
+			const_matr[finger_base_start + EachFingerBoneNum * k] = Matr(trans_y, config->bonelen[bone_finger_base_connect_finger_mcp_start + EachFingerBoneNum * k], false);
+			const_matr[finger_pip_first_start + EachFingerBoneNum * k] = Matr(trans_y, config->bonelen[bone_finger_pip_first_connect_finger_base_start + EachFingerBoneNum * k], false);
+			const_matr[finger_pip_second_start + EachFingerBoneNum * k] = Matr(trans_y, config->bonelen[bone_finger_pip_second_connect_pip_first_start + EachFingerBoneNum * k], false);
+			//Actually there are two points for DIP in each finger (NYU dataset) and two points for TIP in each finger(but here we only use 1 for DIP and TIP each)
+			const_matr[finger_dip_start + EachFingerBoneNum * k] = Matr(trans_y, config->bonelen[bone_finger_dip_connect_pip_second_start + EachFingerBoneNum * k], false);
+			const_matr[finger_tip_start + EachFingerBoneNum * k] = Matr(trans_y, config->bonelen[bone_finger_tip_connect_dip_start + EachFingerBoneNum * k], false);		
+		}		
+	}
+
+	template <typename Dtype>
+	void HandKinematics<Dtype>::SetupTransformation()
+	{
+		//palm center
+		Homo_mat[palm_center].pb(mp(trans_x, global_trans_x));
+		Homo_mat[palm_center].pb(mp(trans_y, global_trans_y));
+		Homo_mat[palm_center].pb(mp(trans_z, global_trans_z));
+		Homo_mat[palm_center].pb(mp(rot_z, global_rot_z));
+		Homo_mat[palm_center].pb(mp(rot_x, global_rot_x));
+		Homo_mat[palm_center].pb(mp(rot_y, global_rot_y));		
+		//wrist left
+		for (int i = 0; i < (int)Homo_mat[palm_center].size(); i++)
+			Homo_mat[wrist_left].pb(Homo_mat[palm_center][i]);
+	
+		Homo_mat[wrist_left].pb(mp(rot_z, wrist_left_const_rot_z));
+		Homo_mat[wrist_left].pb(mp(rot_x, wrist_left_const_rot_x));
+		Homo_mat[wrist_left].pb(mp(rot_y, wrist_left_const_rot_y));
+		Homo_mat[wrist_left].pb(mp(Const_Matr, wrist_left));
+		//wrist middle(carpals)
+		for (int i = 0; i < (int)Homo_mat[palm_center].size(); i++)
+			Homo_mat[wrist_middle].pb(Homo_mat[palm_center][i]);
+	
+		Homo_mat[wrist_middle].pb(mp(rot_z, wrist_middle_const_rot_z));
+		Homo_mat[wrist_middle].pb(mp(rot_x, wrist_middle_const_rot_x));
+		Homo_mat[wrist_middle].pb(mp(rot_y, wrist_middle_const_rot_y));
+		Homo_mat[wrist_middle].pb(mp(Const_Matr, wrist_middle));		
+		//thumb MCP (wrist right metacarpals)
+		for (int i = 0; i < (int)Homo_mat[palm_center].size(); i++)
+			Homo_mat[thumb_mcp].pb(Homo_mat[palm_center][i]);
+
+		Homo_mat[thumb_mcp].pb(mp(rot_z, thumb_mcp_const_rot_z));
+		Homo_mat[thumb_mcp].pb(mp(rot_x, thumb_mcp_const_rot_x));
+		Homo_mat[thumb_mcp].pb(mp(rot_y, thumb_mcp_const_rot_y));
+		Homo_mat[thumb_mcp].pb(mp(Const_Matr, thumb_mcp));		
+		//thumb PIP
+		for (int i = 0; i < (int)Homo_mat[thumb_mcp].size(); i++)
+			Homo_mat[thumb_pip].pb(Homo_mat[thumb_mcp][i]);
+		Homo_mat[thumb_pip].pb(mp(rot_z, thumb_pip_rot_z));
+		Homo_mat[thumb_pip].pb(mp(rot_y, thumb_pip_rot_y));
+		Homo_mat[thumb_pip].pb(mp(Const_Matr, thumb_pip));		
+		//thumb DIP
+		for (int i = 0; i < (int)Homo_mat[thumb_pip].size(); i++)
+			Homo_mat[thumb_dip].pb(Homo_mat[thumb_pip][i]);
+		Homo_mat[thumb_dip].pb(mp(rot_z, thumb_dip_rot_z));
+		Homo_mat[thumb_dip].pb(mp(Const_Matr, thumb_dip));		
+		//thumb TIP
+		for (int i = 0; i < (int)Homo_mat[thumb_dip].size(); i++)
+			Homo_mat[thumb_tip].pb(Homo_mat[thumb_dip][i]);
+		Homo_mat[thumb_tip].pb(mp(rot_z, thumb_tip_rot_z));
+		Homo_mat[thumb_tip].pb(mp(Const_Matr, thumb_tip));		
+		//Finger 1-4
+		for (int k = 0; k < 4; k++)
+		{
+			//finger mcp
+			for (int i = 0; i < (int)Homo_mat[palm_center].size(); i++)
+				Homo_mat[finger_mcp_start + k].pb(Homo_mat[palm_center][i]);
+		
+			Homo_mat[finger_mcp_start + k].pb(mp(rot_z, finger_mcp_rot_z_start + EachMCPDoFNum * k));
+			Homo_mat[finger_mcp_start + k].pb(mp(rot_x, finger_mcp_rot_x_start + EachMCPDoFNum * k));
+			Homo_mat[finger_mcp_start + k].pb(mp(rot_y, finger_mcp_rot_y_start + EachMCPDoFNum * k));
+			Homo_mat[finger_mcp_start + k].pb(mp(Const_Matr, finger_mcp_start + k));			
+			//finger base
+			for (int i = 0; i < (int)Homo_mat[finger_mcp_start + k].size(); i++)
+				Homo_mat[finger_base_start + EachFingerBoneNum * k].pb(Homo_mat[finger_mcp_start + k][i]);
+			Homo_mat[finger_base_start + EachFingerBoneNum * k].pb(mp(rot_z, finger_base_rot_z_start + EachFingerDoFNum * k));
+			Homo_mat[finger_base_start + EachFingerBoneNum * k].pb(mp(rot_x, finger_base_rot_x_start + EachFingerDoFNum * k));
+			Homo_mat[finger_base_start + EachFingerBoneNum * k].pb(mp(Const_Matr, finger_base_start + EachFingerBoneNum * k));			
+			//finger pip first
+			for (int i = 0; i < (int)Homo_mat[finger_base_start + EachFingerBoneNum * k].size(); i++)
+				Homo_mat[finger_pip_first_start + EachFingerBoneNum * k].pb(Homo_mat[finger_base_start + EachFingerBoneNum * k][i]);
+			Homo_mat[finger_pip_first_start + EachFingerBoneNum * k].pb(mp(rot_x, finger_pip_rot_x_start + EachFingerDoFNum * k));
+			Homo_mat[finger_pip_first_start + EachFingerBoneNum * k].pb(mp(Const_Matr, finger_pip_first_start + EachFingerBoneNum * k));
+			//finger pip second
+			for (int i = 0; i < (int)Homo_mat[finger_pip_first_start + EachFingerBoneNum * k].size(); i++)
+				Homo_mat[finger_pip_second_start + EachFingerBoneNum * k].pb(Homo_mat[finger_pip_first_start + EachFingerBoneNum * k][i]);
+			Homo_mat[finger_pip_second_start + EachFingerBoneNum * k].pb(mp(Const_Matr, finger_pip_second_start + EachFingerBoneNum * k));
+			//finger dip
+			for (int i = 0; i < (int)Homo_mat[finger_pip_second_start + EachFingerBoneNum * k].size(); i++)
+				Homo_mat[finger_dip_start + EachFingerBoneNum * k].pb(Homo_mat[finger_pip_second_start + EachFingerBoneNum * k][i]);
+			Homo_mat[finger_dip_start + EachFingerBoneNum * k].pb(mp(rot_x, finger_dip_rot_x_start + EachFingerDoFNum * k));
+			Homo_mat[finger_dip_start + EachFingerBoneNum * k].pb(mp(Const_Matr, finger_dip_start + EachFingerBoneNum * k));
+			//finger tip
+			for (int i = 0; i < (int)Homo_mat[finger_dip_start + EachFingerBoneNum * k].size(); i++)
+				Homo_mat[finger_tip_start + EachFingerBoneNum * k].pb(Homo_mat[finger_dip_start + EachFingerBoneNum * k][i]);
+			Homo_mat[finger_tip_start + EachFingerBoneNum * k].pb(mp(Const_Matr, finger_tip_start + EachFingerBoneNum * k));
+		}
+		CompileProgram();
+	}
+
+	template <typename Dtype>
+	void HandKinematics<Dtype>::CompileProgram()
+	{
+		//Homo_mat[joint] repeats the whole chain of its parent, so only the suffix after Homo_mat[parent] is emitted
+		//A run of fixed DoFs right before a Const_Matr is folded into chain_matr of that slot (e.g. the three constant rotations of a finger MCP)
+		program.clear();
+		for (int i = 0; i < ConstMatrNum; i++) chain_matr[i] = const_matr[i];
+		for (int i = 0; i < JointNum; i++) //in the order of "forward_seq"
+		{
+			int id = forward_seq[i];
+			int prev_size = prev_seq[i] == -1 ? 0 : Homo_mat[prev_seq[i]].size();
+			program_joint[i].joint_id = id;
+			program_joint[i].parent_id = prev_seq[i];
+			program_joint[i].begin = program.size();
+			int fixed_begin = prev_size; //start of the current run of fixed DoFs
+			for (int r = prev_size; r < (int)Homo_mat[id].size(); r++)
+			{
+				KinematicStep step;
+				step.opt = Homo_mat[id][r].first;
+				step.param_id = Homo_mat[id][r].second;
+				if (step.opt == Const_Matr)
+				{
+					Matr folded;
+					for (int f = fixed_begin; f < r; f++) folded.RMult(Homo_mat[id][f].first, config->initparam[Homo_mat[id][f].second]);
+					chain_matr[step.param_id] = folded * const_matr[step.param_id];
+				}
+				else if (config->isFixed[step.param_id]) continue;
+				else
+				{
+					for (int f = fixed_begin; f < r; f++) //not followed by a Const_Matr, keep them
+					{
+						KinematicStep fixed_step;
+						fixed_step.opt = Homo_mat[id][f].first;
+						fixed_step.param_id = Homo_mat[id][f].second;
+						program.pb(fixed_step);
+					}
+				}
+				program.pb(step);
+				fixed_begin = r + 1;
+			}
+			for (int f = fixed_begin; f < (int)Homo_mat[id].size(); f++)
+			{
+				KinematicStep fixed_step;
+				fixed_step.opt = Homo_mat[id][f].first;
+				fixed_step.param_id = Homo_mat[id][f].second;
+				program.pb(fixed_step);
+			}
+			program_joint[i].end = program.size();
+		}
+		//sparse dependency pattern of the Jacobian: joint i only moves with the free DoFs in Homo_mat[i]
+		for (int i = 0; i < JointNum; i++)
+		{
+			joint_dof[i].clear();
+			for (int r = 0; r < (int)Homo_mat[i].size(); r++) if (Homo_mat[i][r].first != Const_Matr && !config->isFixed[Homo_mat[i][r].second]) joint_dof[i].pb(Homo_mat[i][r].second);
+			joint_dof_mask[i] = 0;
+			for (int d = 0; d < (int)joint_dof[i].size(); d++) joint_dof_mask[i] |= 1ULL << joint_dof[i][d];
+		}
+		//every joint is in the subtree of itself and of each of its ancestors
+		int parent[JointNum];
+		for (int i = 0; i < JointNum; i++)
+		{
+			parent[forward_seq[i]] = prev_seq[i];
+			joint_subtree[i].clear();
+		}
+		for (int i = 0; i < JointNum; i++) for (int a = i; a != -1; a = parent[a]) joint_subtree[a].pb(i);
+	}
+
+	template <typename Dtype>
+	bool HandKinematics<Dtype>::MatchChain()
+	{
+		#define CHAIN_JOINT(joint, parent) { joint, parent },
+		#define CHAIN_STEP(opt, id) { opt, id },
+		#define CHAIN_NONE(...)
+		static const int chain_joint[][2] = { HAND_MODEL_CHAIN(CHAIN_JOINT, CHAIN_NONE, CHAIN_NONE) };
+		static const int chain_step[][2] = { HAND_MODEL_CHAIN(CHAIN_NONE, CHAIN_STEP, CHAIN_NONE) };
+		#undef CHAIN_JOINT
+		#undef CHAIN_STEP
+		#undef CHAIN_NONE
+		if (program.size() != sizeof(chain_step) / sizeof(chain_step[0])) return false;
+		for (int r = 0; r < (int)program.size(); r++) if (program[r].opt != chain_step[r][0] || program[r].param_id != chain_step[r][1]) return false;
+		for (int i = 0; i < JointNum; i++) if (program_joint[i].joint_id != chain_joint[i][0] || program_joint[i].parent_id != chain_joint[i][1]) return false;
+		for (int j = 0; j < ParamNum; j++) if ((config->isFixed[j] != 0) != HAND_MODEL_FIXED_DOF(j)) return false;
+		return true;
+	}
+
+	template <typename Dtype>
+	bool HandKinematics<Dtype>::LoadConfiguration(const char *dir)
+	{
+		return LoadConfiguration(HandModelConfig::Get(dir));
+	}
+
+	template <typename Dtype>
+	bool HandKinematics<Dtype>::LoadConfiguration(std::shared_ptr<const HandModelConfig> shared_config)
+	{
+		if (!shared_config) return false;
+		config = shared_config;
+		for (int i = 0; i < JointNum; i++) Homo_mat[i].clear();
+		SetupConstantMatrices();
+		SetupTransformation();
+		use_chain = MatchChain();
+		Reshape(group_num * LaneWidth); //program.size() changed
+		cache_dof = NULL; //computed with the previous configuration
+		last_batch = 0;
+		return true;
+	}
+
+	template <typename Dtype>
+	void HandKinematics<Dtype>::Reshape(int batSize)
+	{
+		GrowScratch();
+		//Caffe reshapes before every Forward_cpu: the same batch keeps the caches, and with them the state of ForwardIncremental
+		const int new_group_num = (batSize + LaneWidth - 1) / LaneWidth;
+		const size_t frame_num = keep_step_frame ? (size_t)new_group_num * program.size() * FrameSize * LaneWidth : 0;
+		if (new_group_num == group_num && step_frame.size() == frame_num) return;
+		group_num = new_group_num;
+		dof_value.resize(group_num * ParamNum * LaneWidth);
+		dof_cos.resize(group_num * ParamNum * LaneWidth);
+		dof_sin.resize(group_num * ParamNum * LaneWidth);
+		prev_mat.resize(group_num * JointNum * FrameSize * LaneWidth);
+		step_frame.resize(frame_num);
+		cache_dof = NULL;
+		last_batch = 0;
+	}
+
+	template <typename Dtype>
+	void HandKinematics<Dtype>::SetForwardOnly(bool forward_only)
+	{
+		if (keep_step_frame == !forward_only) return;
+		keep_step_frame = !forward_only;
+		std::vector<Real>().swap(step_frame); //released, not only cleared
+		if (keep_step_frame) step_frame.resize(group_num * program.size() * FrameSize * LaneWidth);
+		cache_dof = NULL; //computed without step frames, or with ones that are gone
+		last_batch = 0;
+	}
+
+	//One scratch per thread that may run a sample of the next parallel loop, and one for the calling thread itself if it
+	//already runs in a parallel region of the caller (e.g. one instance per tracker thread: its own loops then run on
+	//thread 0 of a team of one, ReferenceGradient on the caller's thread). The thread count can change between calls
+	//(omp_set_num_threads), so this runs again right before each loop, where no other thread reads scratch
+	template <typename Dtype>
+	void HandKinematics<Dtype>::GrowScratch()
+	{
+		int thread_num = 1;
+	#ifdef _OPENMP
+		thread_num = std::max(1, omp_get_max_threads());
+		if (omp_in_parallel()) thread_num = std::max(thread_num, omp_get_thread_num() + 1);
+	#endif
+		if (scratch.size() < (size_t)thread_num) scratch.resize(thread_num);
+	}
+
+	template <typename Dtype>
+	HandModelScratch<typename HandKinematics<Dtype>::Real>& HandKinematics<Dtype>::ThreadScratch()
+	{
+	#ifdef _OPENMP
+		return scratch[omp_get_thread_num()];
+	#else
+		return scratch[0];
+	#endif
+	}
+
+	template <typename Dtype>
+	Matr HandKinematics<Dtype>::GetMatrix(matrix_operation opt, int bottom_id, int param_id, bool is_gradient, const Dtype *bottom_data)
+	{		
+		return opt == Const_Matr ? const_matr[param_id] : Matr(opt, GetParam(bottom_id, param_id, bottom_data), is_gradient);
+	}
+
+	template <typename Dtype>
+	double HandKinematics<Dtype>::GetParam(int bottom_id, int param_id, const Dtype *bottom_data)
+	{
+		return config->isFixed[param_id] ? config->initparam[param_id] : bottom_data[bottom_id + param_id] + config->initparam[param_id];
+	}
+
+	template <typename Dtype>
+	void HandKinematics<Dtype>::PrepareDoF(int batSize, const Dtype *dof, int dof_stride)
+	{
+		//lanes past the end of the batch are padded with 0
+		const int batch_group = (batSize + LaneWidth - 1) / LaneWidth;
+		for (int g = 0; g < batch_group; g++)
+			for (int j = 0; j < ParamNum; j++)
+				for (int l = 0; l < LaneWidth; l++)
+				{
+					int t = g * LaneWidth + l;
+					dof_value[(g * ParamNum + j) * LaneWidth + l] = t < batSize ? (Real)GetParam(t * dof_stride, j, dof) : (Real)0.0;
+				}
+		const int n = batch_group * ParamNum * LaneWidth;
+		//the whole batch in one SIMD sweep, split in blocks only to spread it over threads
+		const int block = 4096;
+	#ifdef _OPENMP
+		#pragma omp parallel for schedule(static)
+	#endif
+		for (int i = 0; i < n; i += block) sincos_array(&dof_value[i], &dof_sin[i], &dof_cos[i], std::min(block, n - i));
+	}
+
+	//The caches hold batSize poses of dof with the values it has now. The values are compared as well, not only the
+	//buffer, since the caller may change the poses in place between Forward and Backward (batSize * ParamNum compares)
+	template <typename Dtype>
+	bool HandKinematics<Dtype>::CachedDoF(int batSize, const Dtype *dof, int dof_stride)
+	{
+		if (cache_dof != dof || cache_batch != batSize) return false;
+		for (int t = 0; t < batSize; t++)
+		{
+			const Real *value = &dof_value[t / LaneWidth * ParamNum * LaneWidth + t % LaneWidth];
+			for (int j = 0; j < ParamNum; j++)
+				if (!config->isFixed[j] && value[j * LaneWidth] != (Real)GetParam(t * dof_stride, j, dof)) return false;
+		}
+		return true;
+	}
+
+	//Right multiplies m (top 3 rows of the current matrix, one lane per sample) by the matrix of one step.
+	//A rotation changes two columns a and b: (a, b) <- (a * cos + b * sin, b * cos - a * sin),
+	//rot_x changes (1, 2), rot_y (0, 2) and rot_z (0, 1). A translation along axis k adds column k * x to column 3.
+	//x, y are (cos, sin) for rotations and (value, -) for translations, k is the matrix of Const_Matr.
+	template <int Opt, class Real>
+	inline void ForwardStep(Lane<Real> *m, const Lane<Real> &x, const Lane<Real> &y, const double *k)
+	{
+		typedef Lane<Real> L;
+		if (Opt <= rot_z)
+		{
+			const int a = Opt == rot_x ? 1 : 0, b = Opt == rot_z ? 1 : 2;
+			for (int row = 0; row < FrameSize; row += 4)
+			{
+				L ma = m[row + a], mb = m[row + b];
+				m[row + a] = ma * x + mb * y;
+				m[row + b] = mb * x - ma * y;
+			}
+		}
+		else if (Opt <= trans_z)
+		{
+			for (int row = 0; row < FrameSize; row += 4) m[row + 3] += m[row + Opt - trans_x] * x;
+		}
+		else //constant rigid transformation
+		{
+			for (int row = 0; row < FrameSize; row += 4)
+			{
+				L m0 = m[row], m1 = m[row + 1], m2 = m[row + 2];
+				for (int col = 0; col < 4; col++) m[row + col] = (col == 3 ? m[row + 3] : L(0.0)) + m0 * L((Real)k[col]) + m1 * L((Real)k[4 + col]) + m2 * L((Real)k[8 + col]);
+			}
+		}
+	}
+
+	//Step of the unrolled chain: Opt and Id are constants, so there is no dispatch and the DoF lanes are read at fixed offsets
+	template <int Opt, int Id, class Real>
+	inline void ForwardChainStep(Lane<Real> *m, const Real *value, const Real *c, const Real *sn, const Matr *chain_matr)
+	{
+		typedef Lane<Real> L;
+		if (Opt == Const_Matr) ForwardStep<Opt>(m, L(0.0), L(0.0), chain_matr[Id].v);
+		else if (Opt <= rot_z) ForwardStep<Opt>(m, L::load(c + Id * L::width), L::load(sn + Id * L::width), NULL);
+		else ForwardStep<Opt>(m, L::load(value + Id * L::width), L(0.0), NULL);
+	}
+
+	//Runs the program for the LaneWidth samples of one group at once
+	template <typename Dtype>
+	void HandKinematics<Dtype>::Forward(int group_id)
+	{
+		typedef Lane<Real> L;
+		const Real *value = &dof_value[group_id * ParamNum * LaneWidth];
+		const Real *c = &dof_cos[group_id * ParamNum * LaneWidth], *sn = &dof_sin[group_id * ParamNum * LaneWidth];
+		Real *pm = &prev_mat[group_id * JointNum * FrameSize * LaneWidth];
+		Real *frame = keep_step_frame ? &step_frame[group_id * program.size() * FrameSize * LaneWidth] : NULL;
+		if (use_chain) //HAND_MODEL_CHAIN expanded into straight-line code, r follows the steps of program
+		{
+			int r = 0;
+		#define FORWARD_CHAIN_BEGIN(joint, parent) { L m[FrameSize]; for (int e = 0; e < FrameSize; e++) m[e] = (parent) == -1 ? L(e % 5 == 0 ? 1.0 : 0.0) : L::load(pm + ((parent) * FrameSize + e) * LaneWidth);
+		#define FORWARD_CHAIN_STEP(opt, id) if (frame != NULL) for (int e = 0; e < FrameSize; e++) m[e].store(frame + (r * FrameSize + e) * LaneWidth); r++; ForwardChainStep<opt, id>(m, value, c, sn, chain_matr);
+		#define FORWARD_CHAIN_END(joint) for (int e = 0; e < FrameSize; e++) m[e].store(pm + ((joint) * FrameSize + e) * LaneWidth); }
+			HAND_MODEL_CHAIN(FORWARD_CHAIN_BEGIN, FORWARD_CHAIN_STEP, FORWARD_CHAIN_END)
+		#undef FORWARD_CHAIN_BEGIN
+		#undef FORWARD_CHAIN_STEP
+		#undef FORWARD_CHAIN_END
+			return;
+		}
+		for (int i = 0; i < JointNum; i++) ForwardJoint(group_id, i); //in the order of "forward_seq"
+	}
+
+	//Runs the segment of program_joint[i] for one group, prev_mat of its parent must be up to date
+	template <typename Dtype>
+	void HandKinematics<Dtype>::ForwardJoint(int group_id, int i)
+	{
+		typedef Lane<Real> L;
+		const Real *value = &dof_value[group_id * ParamNum * LaneWidth];
+		const Real *c = &dof_cos[group_id * ParamNum * LaneWidth], *sn = &dof_sin[group_id * ParamNum * LaneWidth];
+		Real *pm = &prev_mat[group_id * JointNum * FrameSize * LaneWidth];
+		Real *frame = keep_step_frame ? &step_frame[group_id * program.size() * FrameSize * LaneWidth] : NULL;
+		const KinematicJoint &seg = program_joint[i];
+		L m[FrameSize];
+		for (int e = 0; e < FrameSize; e++)
+			m[e] = seg.parent_id == -1 ? L(e % 5 == 0 ? 1.0 : 0.0) : L::load(pm + (seg.parent_id * FrameSize + e) * LaneWidth);
+		for (int r = seg.begin; r < seg.end; r++)
+		{
+			const KinematicStep &step = program[r];
+			if (frame != NULL) for (int e = 0; e < FrameSize; e++) m[e].store(frame + (r * FrameSize + e) * LaneWidth);
+			const int id = step.param_id;
+			switch (step.opt)
+			{
+			case rot_x: ForwardStep<rot_x>(m, L::load(c + id * LaneWidth), L::load(sn + id * LaneWidth), NULL); break;
+			case rot_y: ForwardStep<rot_y>(m, L::load(c + id * LaneWidth), L::load(sn + id * LaneWidth), NULL); break;
+			case rot_z: ForwardStep<rot_z>(m, L::load(c + id * LaneWidth), L::load(sn + id * LaneWidth), NULL); break;
+			case trans_x: ForwardStep<trans_x>(m, L::load(value + id * LaneWidth), L(0.0), NULL); break;
+			case trans_y: ForwardStep<trans_y>(m, L::load(value + id * LaneWidth), L(0.0), NULL); break;
+			case trans_z: ForwardStep<trans_z>(m, L::load(value + id * LaneWidth), L(0.0), NULL); break;
+			default: ForwardStep<Const_Matr>(m, L(0.0), L(0.0), chain_matr[id].v); break;
+			}
+		}
+		for (int e = 0; e < FrameSize; e++) m[e].store(pm + (seg.joint_id * FrameSize + e) * LaneWidth);
+	}
+
+	template <typename Dtype>
+	void HandKinematics<Dtype>::Forward(int batSize, const Dtype *dof, int dof_stride, Dtype *joint, int joint_stride, Dtype *frame, int frame_stride)
+	{
+		if ((batSize + LaneWidth - 1) / LaneWidth > group_num) Reshape(batSize);
+		PrepareDoF(batSize, dof, dof_stride);
+	#ifdef _OPENMP
+		#pragma omp parallel for schedule(static)
+	#endif
+		for (int g = 0; g < (batSize + LaneWidth - 1) / LaneWidth; g++) 
+		{
+			Forward(g);
+			CopyJoint(g, batSize, joint, joint_stride, frame, frame_stride);
+		}
+		cache_dof = dof;
+		cache_batch = batSize;
+		last_batch = 0;
+	}
+
+	template <typename Dtype>
+	void HandKinematics<Dtype>::CopyJoint(int group_id, int batSize, Dtype *joint, int joint_stride, Dtype *frame, int frame_stride)
+	{
+		const Real *pm = &prev_mat[group_id * JointNum * FrameSize * LaneWidth];
+		for (int l = 0; l < LaneWidth && group_id * LaneWidth + l < batSize; l++)
+		{
+			Dtype *t_joint = joint + (group_id * LaneWidth + l) * joint_stride;
+			for (int i = 0; i < JointNum; i++) for (int j = 0; j < 3; j++) t_joint[i * 3 + j] = pm[(i * FrameSize + j * 4 + 3) * LaneWidth + l];
+			if (frame == NULL) continue;
+			Dtype *t_frame = frame + (group_id * LaneWidth + l) * frame_stride;
+			for (int e = 0; e < JointNum * FrameSize; e++) t_frame[e] = pm[e * LaneWidth + l];
+		}
+	}
+
+	//A joint only moves with the free DoFs of its whole chain (joint_dof), so after the DoFs in changed
+	//exactly the joints with one of them in joint_dof_mask are recomputed, parents before children as in "forward_seq"
+	template <typename Dtype>
+	int HandKinematics<Dtype>::ForwardIncremental(int batSize, const Dtype *dof, int dof_stride, Dtype *joint, int joint_stride, Dtype *frame, int frame_stride)
+	{
+		if (batSize != last_batch || (batSize + LaneWidth - 1) / LaneWidth > group_num)
+		{
+			Forward(batSize, dof, dof_stride, joint, joint_stride, frame, frame_stride);
+			last_dof.resize(batSize * ParamNum);
+			for (int t = 0; t < batSize; t++) for (int j = 0; j < ParamNum; j++) last_dof[t * ParamNum + j] = dof[t * dof_stride + j];
+			last_batch = batSize;
+			return (batSize + LaneWidth - 1) / LaneWidth * JointNum;
+		}
+		const int batch_group = (batSize + LaneWidth - 1) / LaneWidth;
+		int recomputed = 0;
+	#ifdef _OPENMP
+		#pragma omp parallel for schedule(static) reduction(+:recomputed)
+	#endif
+		for (int g = 0; g < batch_group; g++)
+		{
+			unsigned long long changed = 0;
+			for (int t = g * LaneWidth; t < std::min((g + 1) * LaneWidth, batSize); t++)
+				for (int j = 0; j < ParamNum; j++)
+				{
+					if (config->isFixed[j] || dof[t * dof_stride + j] == last_dof[t * ParamNum + j]) continue;
+					last_dof[t * ParamNum + j] = dof[t * dof_stride + j];
+					changed |= 1ULL << j;
+				}
+			if (changed == 0) continue;
+			for (int j = 0; j < ParamNum; j++)
+			{
+				if (!(changed >> j & 1)) continue;
+				const int k = (g * ParamNum + j) * LaneWidth;
+				for (int l = 0; l < LaneWidth; l++) dof_value[k + l] = g * LaneWidth + l < batSize ? (Real)GetParam((g * LaneWidth + l) * dof_stride, j, dof) : (Real)0.0;
+				sincos_array(&dof_value[k], &dof_sin[k], &dof_cos[k], LaneWidth);
+			}
+			for (int i = 0; i < JointNum; i++)
+				if (changed & joint_dof_mask[program_joint[i].joint_id])
+				{
+					ForwardJoint(g, i);
+					recomputed++;
+				}
+		}
+		for (int g = 0; g < batch_group; g++) CopyJoint(g, batSize, joint, joint_stride, frame, frame_stride);
+		cache_dof = dof;
+		cache_batch = batSize;
+		return recomputed;
+	}
+
+	//Jacobian of every joint of one sample, following the tree of "forward_seq" instead of each Homo_mat on its own:
+	//the frame before each step of the suffix of Homo_mat[joint] after Homo_mat[parent] is computed once (children
+	//start from the frame of their parent), and so is the derivative of the frame after a step, left[r] * d step / d x.
+	//Joint i below the step then has Jacobian left[r] * (d step / d x) * q, where q is joint i in the frame after the step (a rigid inverse).
+	//Only Homo_mat, const_matr and GetMatrix are used, not program or chain_matr, so it also checks the folding of CompileProgram
+	template <typename Dtype>
+	void HandKinematics<Dtype>::Jacobian(const Dtype *dof, HandModelScratch<Real> &s)
+	{
+		int r = 0; //steps of the Homo_mat suffixes in the order of "forward_seq"
+		for (int i = 0; i < JointNum; i++)
+		{
+			const int id = forward_seq[i], parent = prev_seq[i];
+			Matr m = parent == -1 ? Matr() : s.joint_mat[parent];
+			for (int h = parent == -1 ? 0 : (int)Homo_mat[parent].size(); h < (int)Homo_mat[id].size(); h++, r++)
+			{
+				s.step_left[r] = m;
+				m *= GetMatrix(Homo_mat[id][h].first, 0, Homo_mat[id][h].second, false, dof);
+			}
+			s.joint_mat[id] = m;
+		}
+		r = 0;
+		for (int i = 0; i < JointNum; i++)
+		{
+			const int id = forward_seq[i], parent = prev_seq[i];
+			for (int h = parent == -1 ? 0 : (int)Homo_mat[parent].size(); h < (int)Homo_mat[id].size(); h++, r++)
+			{
+				const KinematicStep step = { Homo_mat[id][h].first, Homo_mat[id][h].second };
+				if (step.opt == Const_Matr || config->isFixed[step.param_id]) continue;
+			#ifdef HAND_MODEL_SCREW_JACOBIAN
+				//world axis a of the step (column of the frame before it, -y for rot_y as in AdjointStep) through its origin o:
+				//a rotation moves joint i by a x (joint i - o), a translation by a
+				const Matr &left = s.step_left[r];
+				const int c = step.opt % 3;
+				double a[3];
+				for (int k = 0; k < 3; k++) a[k] = step.opt == rot_y ? -left.v[k * 4 + c] : left.v[k * 4 + c];
+				for (int d = 0; d < (int)joint_subtree[id].size(); d++)
+				{
+					const int below = joint_subtree[id][d];
+					if (step.opt > rot_z)
+					{
+						s.Jacobian[below][step.param_id] = Vec(a[0], a[1], a[2], 0.0);
+						continue;
+					}
+					double p[3];
+					for (int k = 0; k < 3; k++) p[k] = s.joint_mat[below].v[k * 4 + 3] - left.v[k * 4 + 3];
+					s.Jacobian[below][step.param_id] = Vec(a[1] * p[2] - a[2] * p[1], a[2] * p[0] - a[0] * p[2], a[0] * p[1] - a[1] * p[0], 0.0);
+				}
+				continue;
+			#endif
+				const double x = GetParam(0, step.param_id, dof);
+				Matr derivative = s.step_left[r] * Matr(step.opt, x, true);
+				Matr after = s.step_left[r];
+				after.RMult(step.opt, x);
+				for (int d = 0; d < (int)joint_subtree[id].size(); d++)
+				{
+					const int below = joint_subtree[id][d];
+					double p[3], q[3];
+					for (int k = 0; k < 3; k++) p[k] = s.joint_mat[below].v[k * 4 + 3] - after.v[k * 4 + 3];
+					for (int c = 0; c < 3; c++) q[c] = after.v[c] * p[0] + after.v[4 + c] * p[1] + after.v[8 + c] * p[2];
+					s.Jacobian[below][step.param_id] = derivative * Vec(q[0], q[1], q[2], 1.0);
+				}
+			}
+		}
+	}
+
+	//Joint locations of one sample as the product of the whole Homo_mat in double precision
+	template <typename Dtype>
+	void HandKinematics<Dtype>::ReferenceJoint(const Dtype *dof, double *joint)
+	{
+		for (int i = 0; i < JointNum; i++)
+		{
+			Matr m;
+			for (int r = 0; r < (int)Homo_mat[i].size(); r++) m *= GetMatrix(Homo_mat[i][r].first, 0, Homo_mat[i][r].second, false, dof);
+			for (int k = 0; k < 3; k++) joint[i * 3 + k] = m.v[k * 4 + 3];
+		}
+	}
+
+	//Core idea: (ABCD)'=A'(BCD)+A(BCD)'    (BCD)'=B'(CD)+B(CD)'   (CD)'=C'D+CD'
+	//Jacobian[i][j][0] : \frac{\partial x[i][0]}{\partial d[j]}  partial of x coordinate value of t_joint i with regard to the j-th DoF
+	//Jacobian[i][j][1] : \frac{\partial x[i][1]}{\partial d[j]}  partial of y coordinate value of t_joint i with regard to the j-th DoF
+	//Jacobian[i][j][2] : \frac{\partial x[i][2]}{\partial d[j]}  partial of z coordinate value of t_joint i with regard to the j-th DoF
+	//dof_diff of one sample from the Jacobian, also Backward with HAND_MODEL_JACOBIAN_BACKWARD (only the entries in joint_dof are filled and read, fixed DoFs keep a zero gradient)
+	template <typename Dtype>
+	void HandKinematics<Dtype>::ReferenceGradient(const Dtype *dof, const Dtype *joint_diff, double *grad)
+	{
+		GrowScratch();
+		ReferenceGradient(dof, joint_diff, grad, ThreadScratch());
+	}
+
+	//The same with the scratch of a parallel loop of Backward, which grew it before the loop
+	template <typename Dtype>
+	void HandKinematics<Dtype>::ReferenceGradient(const Dtype *dof, const Dtype *joint_diff, double *grad, HandModelScratch<Real> &s)
+	{
+		Jacobian(dof, s);
+		for (int j = 0; j < ParamNum; j++) grad[j] = 0.0;
+		for (int i = 0; i < JointNum; i++)
+		{
+			for (int d = 0; d < (int)joint_dof[i].size(); d++)
+			{
+				int j = joint_dof[i][d];
+				for (int k = 0; k < 3; k++) grad[j] += s.Jacobian[i][j][k] * joint_diff[i * 3 + k];
+			}
+		}
+	}
+
+	//Gradient of one step whose frame before the step is mat, for the force f and moment m of its joint (see BackwardAdjoint)
+	template <int Opt, class Real>
+	inline Lane<Real> AdjointStep(const Real *mat, const Lane<Real> *f, const Lane<Real> *m)
+	{
+		typedef Lane<Real> L;
+		const int c = Opt % 3; //axis x, y or z
+		L a[3], g[3];
+		for (int k = 0; k < 3; k++) a[k] = L::load(mat + (k * 4 + c) * L::width);
+		if (Opt == rot_y) for (int k = 0; k < 3; k++) a[k] = L(0.0) - a[k];
+		if (Opt <= rot_z)
+		{
+			L o[3];
+			for (int k = 0; k < 3; k++) o[k] = L::load(mat + (k * 4 + 3) * L::width);
+			g[0] = m[0] - (o[1] * f[2] - o[2] * f[1]);
+			g[1] = m[1] - (o[2] * f[0] - o[0] * f[2]);
+			g[2] = m[2] - (o[0] * f[1] - o[1] * f[0]);
+		}
+		else for (int k = 0; k < 3; k++) g[k] = f[k];
+		return a[0] * g[0] + a[1] * g[1] + a[2] * g[2];
+	}
+
+	//Step of the unrolled chain, Const_Matr has no gradient and vanishes at compile time
+	template <int Opt, int Id, class Real>
+	inline void AdjointChainStep(const Real *mat, const Lane<Real> *f, const Lane<Real> *m, Real (*grad)[Lane<Real>::width])
+	{
+		if (Opt != Const_Matr) AdjointStep<Opt>(mat, f, m).store(grad[Id]);
+	}
+
+	//Reverse mode: joint_diff of every joint is summed up the tree (leaves first) into a force f = sum(joint_diff)
+	//and a moment m = sum(t_joint x joint_diff) over the subtree. A step of the program rotating about world axis a
+	//through world point o then gets gradient a.(m - o x f), and a step translating along a gets a.f,
+	//where f and m belong to the joint whose segment contains the step.
+	//rot_y of Matrix4 turns the opposite way of the right-hand rule, so its axis is -y.
+	//a and o are read from the step frames cached by Forward, so no transformation is recomputed here.
+	//A frame_diff G = [G_R G_t] of a joint frame [R t] adds G_t to its joint_diff, and sum_c R_c x G_c over the columns c
+	//of the rotation to its moment: a rotation turns R_c by a x R_c, and G_c.(a x R_c) = a.(R_c x G_c).
+	//Like Forward it runs the LaneWidth samples of one group at once.
+	template <typename Dtype>
+	void HandKinematics<Dtype>::BackwardAdjoint(int group_id, int batSize, const Dtype *joint_diff, int joint_diff_stride, Dtype *dof_diff, int dof_diff_stride,
+		const Dtype *frame_diff, int frame_diff_stride, HandModelScratch<Real> &s)
+	{
+		typedef Lane<Real> L;
+		const Real *pm = &prev_mat[group_id * JointNum * FrameSize * LaneWidth];
+		const Real *frame = &step_frame[group_id * program.size() * FrameSize * LaneWidth];
+		const int lane_num = std::min((int)LaneWidth, batSize - group_id * LaneWidth);
+		L f[JointNum][3], m[JointNum][3];
+		for (int i = 0; i < JointNum; i++)
+		{
+			if (frame_diff != NULL)
+				for (int e = 0; e < FrameSize; e++)
+					for (int l = 0; l < LaneWidth; l++) s.frame_diff[e][l] = l < lane_num ? (Real)frame_diff[(group_id * LaneWidth + l) * frame_diff_stride + i * FrameSize + e] : (Real)0.0;
+			for (int k = 0; k < 3; k++)
+			{
+				for (int l = 0; l < LaneWidth; l++) s.joint_diff[i][k][l] = l < lane_num ? (Real)joint_diff[(group_id * LaneWidth + l) * joint_diff_stride + i * 3 + k] : (Real)0.0;
+				f[i][k] = L::load(s.joint_diff[i][k]);
+				if (frame_diff != NULL) f[i][k] += L::load(s.frame_diff[k * 4 + 3]);
+			}
+			L p[3];
+			for (int k = 0; k < 3; k++) p[k] = L::load(pm + (i * FrameSize + k * 4 + 3) * LaneWidth);
+			m[i][0] = p[1] * f[i][2] - p[2] * f[i][1];
+			m[i][1] = p[2] * f[i][0] - p[0] * f[i][2];
+			m[i][2] = p[0] * f[i][1] - p[1] * f[i][0];
+			if (frame_diff == NULL) continue;
+			for (int c = 0; c < 3; c++)
+			{
+				L rc[3], gc[3];
+				for (int k = 0; k < 3; k++)
+				{
+					rc[k] = L::load(pm + (i * FrameSize + k * 4 + c) * LaneWidth);
+					gc[k] = L::load(s.frame_diff[k * 4 + c]);
+				}
+				m[i][0] += rc[1] * gc[2] - rc[2] * gc[1];
+				m[i][1] += rc[2] * gc[0] - rc[0] * gc[2];
+				m[i][2] += rc[0] * gc[1] - rc[1] * gc[0];
+			}
+		}
+		for (int i = JointNum - 1; i > 0; i--) //children before parents
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				f[prev_seq[i]][k] += f[forward_seq[i]][k];
+				m[prev_seq[i]][k] += m[forward_seq[i]][k];
+			}
+		}
+		for (int j = 0; j < ParamNum; j++) for (int l = 0; l < LaneWidth; l++) s.grad[j][l] = (Real)0.0;
+		if (use_chain)
+		{
+			int r = 0;
+			const L *fj, *mj;
+		#define BACKWARD_CHAIN_BEGIN(joint, parent) fj = f[joint]; mj = m[joint];
+		#define BACKWARD_CHAIN_STEP(opt, id) AdjointChainStep<opt, id>(frame + r * FrameSize * LaneWidth, fj, mj, s.grad); r++;
+		#define BACKWARD_CHAIN_END(joint)
+			HAND_MODEL_CHAIN(BACKWARD_CHAIN_BEGIN, BACKWARD_CHAIN_STEP, BACKWARD_CHAIN_END)
+		#undef BACKWARD_CHAIN_BEGIN
+		#undef BACKWARD_CHAIN_STEP
+		#undef BACKWARD_CHAIN_END
+		}
+		else for (int i = 0; i < JointNum; i++)
+		{
+			const KinematicJoint &seg = program_joint[i];
+			const L *fj = f[seg.joint_id], *mj = m[seg.joint_id];
+			for (int r = seg.begin; r < seg.end; r++)
+			{
+				const KinematicStep &step = program[r];
+				if (step.opt == Const_Matr || config->isFixed[step.param_id]) continue;
+				const Real *mat = frame + r * FrameSize * LaneWidth; //frame before the step
+				L g;
+				switch (step.opt)
+				{
+				case rot_x: g = AdjointStep<rot_x>(mat, fj, mj); break;
+				case rot_y: g = AdjointStep<rot_y>(mat, fj, mj); break;
+				case rot_z: g = AdjointStep<rot_z>(mat, fj, mj); break;
+				case trans_x: g = AdjointStep<trans_x>(mat, fj, mj); break;
+				case trans_y: g = AdjointStep<trans_y>(mat, fj, mj); break;
+				default: g = AdjointStep<trans_z>(mat, fj, mj); break;
+				}
+				g.store(s.grad[step.param_id]);
+			}
+		}
+		for (int l = 0; l < lane_num; l++)
+			for (int j = 0; j < ParamNum; j++) dof_diff[(group_id * LaneWidth + l) * dof_diff_stride + j] = s.grad[j][l];
+	}
+
+	template <typename Dtype>
+	void HandKinematics<Dtype>::Backward(int batSize, const Dtype *dof, int dof_stride, const Dtype *joint_diff, int joint_diff_stride, Dtype *dof_diff, int dof_diff_stride,
+		const Dtype *frame_diff, int frame_diff_stride)
+	{
+		if ((batSize + LaneWidth - 1) / LaneWidth > group_num) Reshape(batSize);
+		GrowScratch();
+		SetForwardOnly(false); //the sweep reads the step frames
+	#ifdef HAND_MODEL_JACOBIAN_BACKWARD
+		if (frame_diff == NULL) //the Jacobian only covers joint locations, a frame_diff goes through the reverse-mode sweep below
+		{
+		#ifdef _OPENMP
+			#pragma omp parallel for schedule(static)
+		#endif
+			for (int t = 0; t < batSize; t++)
+			{
+				double grad[ParamNum];
+				ReferenceGradient(dof + t * dof_stride, joint_diff + t * joint_diff_stride, grad, ThreadScratch());
+				for (int j = 0; j < ParamNum; j++) dof_diff[t * dof_diff_stride + j] = grad[j];
+			}
+			return;
+		}
+	#endif
+		const int batch_group = (batSize + LaneWidth - 1) / LaneWidth;
+		if (!CachedDoF(batSize, dof, dof_stride)) //Forward did not run on this dof, or it changed since then
+		{
+			PrepareDoF(batSize, dof, dof_stride);
+		#ifdef _OPENMP
+			#pragma omp parallel for schedule(static)
+		#endif
+			for (int g = 0; g < batch_group; g++) Forward(g);
+			cache_dof = dof;
+			cache_batch = batSize;
+			last_batch = 0;
+		}
+	#ifdef _OPENMP
+		#pragma omp parallel for schedule(static)
+	#endif
+		for (int g = 0; g < batch_group; g++) BackwardAdjoint(g, batSize, joint_diff, joint_diff_stride, dof_diff, dof_diff_stride, frame_diff, frame_diff_stride, ThreadScratch());
+	}
+
+	template class HandKinematics<float>;
+	template class HandKinematics<double>;
+}
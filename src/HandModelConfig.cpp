@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "Utility/iostream_binary.h"
+#include "HandModelConfig.h"
+
+namespace hand_model
+{
+	const char *HandModelConfig::BundleName = "HandModel.bundle";
+
+	static const char *TextName[] = { "DofConstraintId.in", "InitialParameters.in", "BoneLength.in", "DofConstraintLowerBound.in", "DofConstraintUpperBound.in" };
+
+	//absolute path of dir without . .. or links, so that every spelling of a directory shares one entry of Get; dir itself if it doesn't exist
+	static std::string CanonicalDir(const std::string &dir)
+	{
+	#ifdef _WIN32
+		char full[_MAX_PATH];
+		if (_fullpath(full, dir.c_str(), _MAX_PATH) != NULL) return full;
+	#else
+		char *full = realpath(dir.c_str(), NULL);
+		if (full != NULL)
+		{
+			std::string canonical(full);
+			free(full);
+			return canonical;
+		}
+	#endif
+		return dir;
+	}
+
+	//seconds and nanoseconds of the last change of filename (nanoseconds where stat has them), false if it doesn't exist
+	static bool ModifiedTime(const std::string &filename, std::pair<time_t, long> &mtime)
+	{
+		struct stat info;
+		if (stat(filename.c_str(), &info) != 0) return false;
+	#if defined(__APPLE__)
+		mtime = std::make_pair(info.st_mtimespec.tv_sec, info.st_mtimespec.tv_nsec);
+	#elif defined(_WIN32)
+		mtime = std::make_pair(info.st_mtime, 0L);
+	#else
+		mtime = std::make_pair(info.st_mtim.tv_sec, info.st_mtim.tv_nsec);
+	#endif
+		return true;
+	}
+
+	std::shared_ptr<const HandModelConfig> HandModelConfig::Get(const std::string &dir)
+	{
+		static std::mutex lock;
+		static std::map<std::string, std::shared_ptr<const HandModelConfig> > loaded;
+		std::lock_guard<std::mutex> guard(lock);
+		const std::string key = CanonicalDir(dir);
+		std::shared_ptr<const HandModelConfig> &config = loaded[key];
+		if (config) return config;
+		//the bundle is only read if no text file was changed after it was saved (or at the same time, the clock of
+		//some file systems only has seconds), and the text files are read if the bundle can't be
+		std::string bundle = key + "/" + BundleName;
+		std::pair<time_t, long> bundle_time, text_time;
+		bool use_bundle = ModifiedTime(bundle, bundle_time);
+		for (size_t i = 0; i < sizeof(TextName) / sizeof(TextName[0]) && use_bundle; i++)
+			if (ModifiedTime(key + "/" + TextName[i], text_time) && text_time >= bundle_time)
+			{
+				std::cerr << TextName[i] << " is not older than " << bundle << ", reading the text files" << std::endl;
+				use_bundle = false;
+			}
+		std::shared_ptr<HandModelConfig> parsed(new HandModelConfig);
+		if (use_bundle && !parsed->LoadBundle(bundle))
+		{
+			std::cerr << "reading the text files instead of " << bundle << std::endl;
+			parsed.reset(new HandModelConfig); //nothing of the bundle read so far is kept
+			use_bundle = false;
+		}
+		if (!use_bundle && !parsed->LoadText(key))
+		{
+			loaded.erase(key);
+			return std::shared_ptr<const HandModelConfig>();
+		}
+		std::cerr << "hand model configuration loaded from " << (use_bundle ? bundle : key + "/*.in") << std::endl;
+		config = parsed;
+		return config;
+	}
+
+	//reads num values of format from filename, false (with a message) if the file is missing or too short
+	template <typename T>
+	static bool ReadValues(const std::string &filename, const char *format, T *value, int num, bool required = true)
+	{
+		FILE *fin = fopen(filename.c_str(), "r");
+		if (fin == NULL)
+		{
+			if (required) std::cerr << "can't open file " << filename << std::endl;
+			return false;
+		}
+		int i = 0;
+		while (i < num && fscanf(fin, format, &value[i]) == 1) i++;
+		fclose(fin);
+		if (i < num) std::cerr << "fail to load " << num << " values from " << filename << std::endl;
+		return i == num;
+	}
+
+	bool HandModelConfig::LoadText(const std::string &dir)
+	{
+		std::string prefix = dir + "/";
+		FILE *fin = fopen((prefix + "DofConstraintId.in").c_str(), "r");
+		if (fin == NULL)
+		{
+			std::cerr << "can't open file " << prefix << "DofConstraintId.in" << std::endl;
+			return false;
+		}
+		for (int i = 0; i < ParamNum; i++) isFixed[i] = 0;
+		int n, id;
+		bool ok = fscanf(fin, "%d", &n) == 1 && n >= 0 && n <= ParamNum;
+		for (int i = 0; i < n && ok; i++)
+		{
+			ok = fscanf(fin, "%d", &id) == 1 && id >= 0 && id < ParamNum;
+			if (ok) isFixed[id] = 1;
+		}
+		fclose(fin);
+		if (!ok)
+		{
+			std::cerr << "fail to load DoF ids from " << prefix << "DofConstraintId.in" << std::endl;
+			return false;
+		}
+		if (!ReadValues(prefix + "InitialParameters.in", "%lf", initparam, ParamNum)) return false;
+		if (!ReadValues(prefix + "BoneLength.in", "%lf", bonelen, BoneNum)) return false;
+		has_bound = ReadValues(prefix + "DofConstraintLowerBound.in", "%f", lower_bound, ParamNum, false)
+			&& ReadValues(prefix + "DofConstraintUpperBound.in", "%f", upper_bound, ParamNum, false);
+		if (!has_bound) for (int i = 0; i < ParamNum; i++) lower_bound[i] = upper_bound[i] = 0.0f;
+		return true;
+	}
+
+	//one array of the bundle, false if it isn't num values of T
+	template <typename T>
+	static bool ReadArray(istream_binary &in, T *value, size_t num)
+	{
+		std::vector<T> data;
+		if (!in.read_array(data) || data.size() != num) return false;
+		std::copy(data.begin(), data.end(), value);
+		return true;
+	}
+
+	//Bundle: the arrays isFixed, initparam, bonelen, has_bound (one unsigned char), lower_bound and upper_bound,
+	//each written by write_array (so the reader checks type and size, and swaps the byte order if needed)
+	bool HandModelConfig::LoadBundle(const std::string &filename)
+	{
+		std::ifstream in(filename.c_str(), std::ios::in | std::ios::binary);
+		if (!in)
+		{
+			std::cerr << "can't open file " << filename << std::endl;
+			return false;
+		}
+		istream_binary in_bin(in);
+		unsigned char bound;
+		if (!ReadArray(in_bin, isFixed, ParamNum) || !ReadArray(in_bin, initparam, ParamNum) || !ReadArray(in_bin, bonelen, BoneNum)
+			|| !ReadArray(in_bin, &bound, 1) || !ReadArray(in_bin, lower_bound, ParamNum) || !ReadArray(in_bin, upper_bound, ParamNum))
+		{
+			std::cerr << filename << " is not a hand model bundle of this build" << std::endl;
+			return false;
+		}
+		has_bound = bound != 0;
+		return true;
+	}
+
+	bool HandModelConfig::SaveBundle(const std::string &filename) const
+	{
+		std::ofstream out(filename.c_str(), std::ios::out | std::ios::binary);
+		if (!out)
+		{
+			std::cerr << "can't open file " << filename << std::endl;
+			return false;
+		}
+		ostream_binary out_bin(out);
+		unsigned char bound = has_bound;
+		out_bin.write_array(isFixed, ParamNum).write_array(initparam, ParamNum).write_array(bonelen, BoneNum);
+		out_bin.write_array(&bound, 1).write_array(lower_bound, ParamNum).write_array(upper_bound, ParamNum);
+		if (!out)
+		{
+			std::cerr << "fail to save binary to " << filename << std::endl;
+			return false;
+		}
+		return true;
+	}
+}
@@ -15,31 +15,9 @@ namespace caffe {
 		this->layer_param_.add_loss_weight(Dtype(1));
 	  }
 	
-	  FILE *fin = fopen("configuration/DofConstraintLowerBound.in", "r");
-	  for (int i = 0; i < ParamNum; i++)
-	  {
-		  fscanf(fin, "%f", &DoFConstraintLowerBound[i]);
-	  }
-	  fclose(fin);
-
-	  fin = fopen("configuration/DofConstraintUpperBound.in", "r");
-	  for (int i = 0; i < ParamNum; i++)
-	  {
-		  fscanf(fin, "%f", &DoFConstraintUpperBound[i]);
-	  }
-	  fclose(fin);
-
-	  fin = fopen("configuration/DofConstraintId.in", "r");
-	  for (int i = 0; i < ParamNum; i++) isConstrained[i] = 0;
-	  int n;
-	  fscanf(fin, "%d", &n);
-	  for (int i = 0; i < n; i++)
-	  {
-		  int id;
-		  fscanf(fin, "%d", &id);
-		  isConstrained[id] = 1;
-	  }
-	  fclose(fin);
+	  config = HandModelConfig::Get("configuration");
+	  CHECK(config) << "can't load the hand model configuration";
+	  CHECK(config->has_bound) << "DofConstraintLowerBound.in and DofConstraintUpperBound.in are needed by DeepHandModelDofConstraintLoss";
 	}
 
 
@@ -63,9 +41,9 @@ namespace caffe {
 		int bottom_id = t * ParamNum;
 		for (int i = 0; i < ParamNum; i++)
 		{
-			if (isConstrained[i]) continue;
-			if (bottom_data[bottom_id + i] > DoFConstraintUpperBound[i]) loss += (bottom_data[bottom_id + i] - DoFConstraintUpperBound[i]) * (bottom_data[bottom_id + i] - DoFConstraintUpperBound[i]);
-			else if (bottom_data[bottom_id + i] < DoFConstraintLowerBound[i]) loss += (bottom_data[bottom_id + i] - DoFConstraintLowerBound[i]) * (bottom_data[bottom_id + i] - DoFConstraintLowerBound[i]);
+			if (config->isFixed[i]) continue;
+			if (bottom_data[bottom_id + i] > config->upper_bound[i]) loss += (bottom_data[bottom_id + i] - config->upper_bound[i]) * (bottom_data[bottom_id + i] - config->upper_bound[i]);
+			else if (bottom_data[bottom_id + i] < config->lower_bound[i]) loss += (bottom_data[bottom_id + i] - config->lower_bound[i]) * (bottom_data[bottom_id + i] - config->lower_bound[i]);
 		}      
 	  }
 	  top[0]->mutable_cpu_data()[0] = loss / batSize;
@@ -85,9 +63,9 @@ namespace caffe {
 		  int bottom_id = t * ParamNum;
 		  for (int i = 0; i < ParamNum; i++)
 		  {
-			  if (isConstrained[i]) continue;
-			  if (bottom_data[bottom_id + i] > DoFConstraintUpperBound[i]) bottom_diff[bottom_id + i] = top_diff * 2 * (bottom_data[bottom_id + i] - DoFConstraintUpperBound[i]);
-			  else if (bottom_data[bottom_id + i] < DoFConstraintLowerBound[i]) bottom_diff[bottom_id + i] = top_diff * 2 * (bottom_data[bottom_id + i] - DoFConstraintLowerBound[i]);
+			  if (config->isFixed[i]) continue;
+			  if (bottom_data[bottom_id + i] > config->upper_bound[i]) bottom_diff[bottom_id + i] = top_diff * 2 * (bottom_data[bottom_id + i] - config->upper_bound[i]);
+			  else if (bottom_data[bottom_id + i] < config->lower_bound[i]) bottom_diff[bottom_id + i] = top_diff * 2 * (bottom_data[bottom_id + i] - config->lower_bound[i]);
 			  else bottom_diff[bottom_id + i] = 0;
 		  }        
 		}
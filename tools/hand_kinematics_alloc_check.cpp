@@ -0,0 +1,105 @@
+//Checks that HandKinematics does not allocate once it is warmed up
+//usage: hand_kinematics_alloc_check [configuration dir]
+//operator new is replaced by a counting one. After one warm-up round on a batch, further rounds of
+//  Forward, Backward (also with a frame_diff), ForwardIncremental and ReferenceGradient
+//on changing poses of the same batch must not allocate. Backward is the reverse-mode sweep, or the Jacobian in the
+//hand_kinematics_alloc_check_jacobian build (HAND_MODEL_JACOBIAN_BACKWARD is a compile-time switch of the kinematics).
+//The return value is 1 if anything allocated.
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <vector>
+#include "HandKinematics.h"
+
+using namespace hand_model;
+
+static std::atomic<long> allocation_count(0);
+
+void *operator new(std::size_t size)
+{
+	allocation_count++;
+	void *p = malloc(size ? size : 1);
+	if (p == NULL) throw std::bad_alloc();
+	return p;
+}
+
+void *operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept
+{
+	free(p);
+}
+
+//allocations of the rounds after the warm-up on batSize poses
+template <typename Dtype>
+long Check(const char *dir, int batSize)
+{
+	const int round_num = 4;
+	HandKinematics<Dtype> kinematics;
+	if (!kinematics.LoadConfiguration(dir)) return -1;
+	std::mt19937 rng(batSize);
+	std::uniform_real_distribution<double> u(-1.0, 1.0);
+	std::vector<Dtype> dof(batSize * ParamNum), joint(batSize * JointNum * 3), joint_diff(batSize * JointNum * 3), dof_diff(batSize * ParamNum);
+	std::vector<Dtype> frame(batSize * JointNum * FrameSize), frame_diff(batSize * JointNum * FrameSize);
+	for (int i = 0; i < (int)dof.size(); i++) dof[i] = (Dtype)u(rng);
+	for (int i = 0; i < (int)joint_diff.size(); i++) joint_diff[i] = (Dtype)u(rng);
+	for (int i = 0; i < (int)frame_diff.size(); i++) frame_diff[i] = (Dtype)u(rng);
+	double grad[ParamNum];
+	kinematics.Reshape(batSize);
+	long count = 0;
+	for (int round = 0; round <= round_num; round++) //round 0 warms up
+	{
+		long start = allocation_count;
+		for (int t = 0; t < batSize; t++) dof[t * ParamNum + (round * 7 + t) % ParamNum] += (Dtype)0.01;
+		kinematics.Forward(batSize, &dof[0], ParamNum, &joint[0], JointNum * 3, &frame[0], JointNum * FrameSize);
+		kinematics.Backward(batSize, &dof[0], ParamNum, &joint_diff[0], JointNum * 3, &dof_diff[0], ParamNum);
+		kinematics.Backward(batSize, &dof[0], ParamNum, &joint_diff[0], JointNum * 3, &dof_diff[0], ParamNum, &frame_diff[0], JointNum * FrameSize);
+		kinematics.ForwardIncremental(batSize, &dof[0], ParamNum, &joint[0], JointNum * 3);
+		dof[0] += (Dtype)0.01;
+		kinematics.ForwardIncremental(batSize, &dof[0], ParamNum, &joint[0], JointNum * 3, &frame[0], JointNum * FrameSize);
+		for (int t = 0; t < batSize; t++) kinematics.ReferenceGradient(&dof[t * ParamNum], &joint_diff[t * JointNum * 3], grad);
+		if (round > 0) count += allocation_count - start;
+	}
+	return count;
+}
+
+int main(int argc, char **argv)
+{
+	const char *dir = argc > 1 ? argv[1] : "configuration";
+	const int batch_list[] = { 1, 37, 256 };
+#ifdef HAND_MODEL_JACOBIAN_BACKWARD
+	printf("Backward : Jacobian (HAND_MODEL_JACOBIAN_BACKWARD)\n");
+#else
+	printf("Backward : reverse-mode sweep\n");
+#endif
+	bool pass = true;
+	for (int b = 0; b < 3; b++)
+	{
+		long count[2] = { Check<float>(dir, batch_list[b]), Check<double>(dir, batch_list[b]) };
+		if (count[0] < 0 || count[1] < 0) return 1;
+		printf("batch %4d : float %ld, double %ld allocations after the warm-up\n", batch_list[b], count[0], count[1]);
+		if (count[0] != 0 || count[1] != 0) pass = false;
+	}
+	printf("%s\n", pass ? "PASS" : "FAIL");
+	return pass ? 0 : 1;
+}
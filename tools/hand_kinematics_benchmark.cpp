@@ -0,0 +1,121 @@
+//Throughput of HandKinematics in poses/second, printed as JSON so runs of different releases can be compared
+//usage: hand_kinematics_benchmark [configuration dir] [output.json]
+//Every combination of precision (float, double), batch size (1, 32, 256, 4096) and thread count (1, 2, 4, ... below the OpenMP maximum, then the maximum itself) runs
+//  forward  : Forward
+//  backward : Forward followed by Backward on the same poses
+//  jacobian : Jacobian of every joint of one pose (ReferenceGradient), pose by pose on one thread
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "HandKinematics.h"
+
+using namespace hand_model;
+
+const double MinSeconds = 0.2; //each measurement repeats until it took at least this long
+
+template <typename Dtype>
+struct BenchmarkData
+{
+	std::vector<Dtype> dof, joint, joint_diff, dof_diff;
+	BenchmarkData(int batSize)
+		: dof(batSize * ParamNum), joint(batSize * JointNum * 3), joint_diff(batSize * JointNum * 3), dof_diff(batSize * ParamNum)
+	{
+		std::mt19937 rng(batSize);
+		std::uniform_real_distribution<double> u(-1.0, 1.0);
+		for (int i = 0; i < (int)dof.size(); i++) dof[i] = u(rng);
+		for (int i = 0; i < (int)joint_diff.size(); i++) joint_diff[i] = u(rng);
+	}
+};
+
+double Now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//poses per second of mode on batSize poses
+template <typename Dtype>
+double Measure(HandKinematics<Dtype> &kinematics, BenchmarkData<Dtype> &data, int batSize, const std::string &mode)
+{
+	int poses = 0;
+	double start = Now(), elapsed = 0.0;
+	do
+	{
+		if (mode == "jacobian")
+		{
+			double grad[ParamNum];
+			for (int t = 0; t < batSize; t++) kinematics.ReferenceGradient(&data.dof[t * ParamNum], &data.joint_diff[t * JointNum * 3], grad);
+		}
+		else
+		{
+			kinematics.Forward(batSize, &data.dof[0], ParamNum, &data.joint[0], JointNum * 3);
+			if (mode == "backward") kinematics.Backward(batSize, &data.dof[0], ParamNum, &data.joint_diff[0], JointNum * 3, &data.dof_diff[0], ParamNum);
+		}
+		poses += batSize;
+		elapsed = Now() - start;
+	} while (elapsed < MinSeconds);
+	return poses / elapsed;
+}
+
+template <typename Dtype>
+bool Run(const char *dir, const char *precision, FILE *out, bool &first)
+{
+	const int batch_list[] = { 1, 32, 256, 4096 };
+	const char *mode_list[] = { "forward", "backward", "jacobian" };
+	int max_thread = 1;
+#ifdef _OPENMP
+	max_thread = omp_get_max_threads();
+#endif
+	std::vector<int> thread_list; //powers of 2 below max_thread, then max_thread itself (e.g. 1 2 4 8 12)
+	for (int thread = 1; thread < max_thread; thread *= 2) thread_list.push_back(thread);
+	thread_list.push_back(max_thread);
+	HandKinematics<Dtype> kinematics;
+	if (!kinematics.LoadConfiguration(dir)) return false;
+	for (int b = 0; b < 4; b++)
+	{
+		BenchmarkData<Dtype> data(batch_list[b]);
+		kinematics.Reshape(batch_list[b]);
+		for (int n = 0; n < (int)thread_list.size(); n++)
+		{
+			const int thread = thread_list[n];
+		#ifdef _OPENMP
+			omp_set_num_threads(thread);
+		#endif
+			for (int m = 0; m < 3; m++)
+			{
+				if (m == 2 && thread > 1) continue; //single threaded by definition
+				double rate = Measure(kinematics, data, batch_list[b], mode_list[m]);
+				fprintf(out, "%s    {\"precision\": \"%s\", \"mode\": \"%s\", \"batch\": %d, \"threads\": %d, \"poses_per_second\": %.1f}",
+					first ? "" : ",\n", precision, mode_list[m], batch_list[b], thread, rate);
+				first = false;
+				fflush(out);
+			}
+		}
+	#ifdef _OPENMP
+		omp_set_num_threads(max_thread);
+	#endif
+	}
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	const char *dir = argc > 1 ? argv[1] : "configuration";
+	FILE *out = argc > 2 ? fopen(argv[2], "w") : stdout;
+	if (out == NULL)
+	{
+		printf("can't open file %s\n", argv[2]);
+		return 1;
+	}
+	int lane_float = Lane<float>::width, lane_double = Lane<double>::width;
+	fprintf(out, "{\n  \"simd_lanes\": {\"float\": %d, \"double\": %d},\n  \"results\": [\n", lane_float, lane_double);
+	bool first = true;
+	bool ok = Run<float>(dir, "float", out, first) && Run<double>(dir, "double", out, first);
+	fprintf(out, "\n  ]\n}\n");
+	if (out != stdout) fclose(out);
+	return ok ? 0 : 1;
+}
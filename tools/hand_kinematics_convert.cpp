@@ -0,0 +1,61 @@
+//Converts a binary file of poses to a binary file of joints without Caffe
+//usage: hand_kinematics_convert input.bin output.bin [configuration dir] [chunk poses]
+//Both files are in the rows/cols format of LoadBinary (FileIOUtility.h): unsigned int rows, unsigned int cols, then rows * cols floats.
+//The input has cols = ParamNum (one pose per row), the output gets cols = JointNum * 3.
+//Both files are memory mapped (MappedBinary) and the poses are converted chunk by chunk (Forward runs the chunk on all cores)
+//straight into the mapped output. The default chunk of 8192 poses keeps the caches of HandKinematics around 20 MB.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "Utility/FileIOUtility.h"
+#include "HandKinematics.h"
+
+using namespace hand_model;
+
+double Now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 3)
+	{
+		printf("usage: hand_kinematics_convert input.bin output.bin [configuration dir] [chunk poses]\n");
+		return 1;
+	}
+	const char *dir = argc > 3 ? argv[3] : "configuration";
+	const int chunk = argc > 4 ? atoi(argv[4]) : 8192;
+	if (chunk <= 0)
+	{
+		printf("chunk poses must be a positive number, got %s\n", argv[4]);
+		printf("usage: hand_kinematics_convert input.bin output.bin [configuration dir] [chunk poses]\n");
+		return 1;
+	}
+	HandKinematics<float> kinematics;
+	if (!kinematics.LoadConfiguration(dir)) return 1;
+
+	MappedBinary<float> input, output;
+	if (!input.Open(argv[1])) return 1;
+	if (input.cols != ParamNum)
+	{
+		cout << argv[1] << " has " << input.cols << " columns, expected " << ParamNum << endl;
+		return 1;
+	}
+	if (!output.Create(argv[2], input.rows, JointNum * 3)) return 1;
+
+	double start = Now();
+	kinematics.SetForwardOnly(true); //no Backward, so the caches only hold the DoFs and the joint frames of a chunk
+	kinematics.Reshape(chunk);
+	for (size_t first = 0; first < input.rows; first += chunk)
+	{
+		int batSize = (int)std::min((size_t)chunk, input.rows - first);
+		kinematics.Forward(batSize, input.row(first), ParamNum, output.mutable_data() + first * JointNum * 3, JointNum * 3);
+	}
+	output.Close();
+	double elapsed = Now() - start;
+	printf("%u poses in %.3f s (%.0f poses/s)\n", input.rows, elapsed, input.rows / elapsed);
+	return 0;
+}
@@ -0,0 +1,258 @@
+//Checks the analytic gradient of HandKinematics against central differences and times each way of getting it
+//usage: hand_kinematics_gradient_check [configuration dir] [pose number] [step]
+//For random poses (CRandom) it compares, for HandKinematics<double> and HandKinematics<float>,
+//  d joint / d dof of every joint coordinate and DoF : Backward (reverse mode) against central differences of Forward
+//  joint_diff * d joint / d dof for a random joint_diff : Backward, ReferenceGradient (Jacobian) and central differences
+//  the same plus frame_diff * d frame / d dof for a random frame_diff (the frames of Forward) : Backward and central differences
+//and prints the worst error of every DoF. The central differences always come from HandKinematics<double>
+//(differences of float joints would mostly measure rounding), float is held to its own, looser tolerance.
+//Then every thread of a parallel region creates, configures and runs its own HandKinematics<double> (one instance per
+//tracker thread), whose Backward and ReferenceGradient must agree with central differences as well, and Backward
+//after the poses changed in place since Forward must give the gradient of the new poses.
+//The return value is 1 if any error is above the tolerance.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "Utility/CRandom.h"
+#include "HandKinematics.h"
+
+using namespace hand_model;
+
+const int RowNum = JointNum * 3; //rows of the Jacobian
+const int FrameNum = JointNum * FrameSize; //values of the frames of one pose
+const double MinSeconds = 0.2;   //each timing repeats until it took at least this long
+
+//largest error that passes: double is bounded by the truncation error of the central differences,
+//float by its rounding (about 100 ulp of the largest Jacobian entry, ~10)
+template <typename Dtype> struct GradientTolerance { static double value() { return 1e-6; } };
+template <> struct GradientTolerance<float> { static double value() { return 1e-4; } };
+
+double Now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//seconds per call of run, after one call to warm up (first touch of the caches, OpenMP threads)
+template <typename Function>
+double Time(Function run)
+{
+	run();
+	int calls = 0;
+	double start = Now(), elapsed = 0.0;
+	do
+	{
+		run();
+		calls++;
+		elapsed = Now() - start;
+	} while (elapsed < MinSeconds);
+	return elapsed / calls;
+}
+
+//Central differences of HandKinematics<double>, the reference for every precision
+struct NumericGradient
+{
+	std::vector<double> jacobian; //[pose][row][dof]
+	std::vector<double> grad;     //[pose][dof] joint_diff * jacobian
+	std::vector<double> grad_frame; //[pose][dof] grad + frame_diff * d frame / d dof
+	double time;                  //seconds per pose
+
+	bool Compute(const char *dir, int pose_num, double step, const std::vector<double> &dof, const std::vector<double> &joint_diff, const std::vector<double> &frame_diff)
+	{
+		HandKinematics<double> kinematics;
+		if (!kinematics.LoadConfiguration(dir)) return false;
+		jacobian.resize(pose_num * RowNum * ParamNum);
+		grad.resize(pose_num * ParamNum);
+		grad_frame.resize(pose_num * ParamNum);
+		std::vector<double> dof_step(2 * ParamNum * ParamNum), joint_step(2 * ParamNum * RowNum), frame_step(2 * ParamNum * FrameNum);
+		time = Time([&]()
+		{
+			for (int t = 0; t < pose_num; t++)
+			{
+				//pose 2j moves DoF j by +step and pose 2j+1 by -step
+				for (int j = 0; j < ParamNum; j++)
+					for (int s = 0; s < 2; s++)
+					{
+						double *d = &dof_step[(2 * j + s) * ParamNum];
+						for (int k = 0; k < ParamNum; k++) d[k] = dof[t * ParamNum + k];
+						d[j] += s == 0 ? step : -step;
+					}
+				kinematics.Forward(2 * ParamNum, &dof_step[0], ParamNum, &joint_step[0], RowNum, &frame_step[0], FrameNum);
+				for (int j = 0; j < ParamNum; j++)
+				{
+					grad[t * ParamNum + j] = 0.0;
+					for (int r = 0; r < RowNum; r++)
+					{
+						double derivative = (joint_step[2 * j * RowNum + r] - joint_step[(2 * j + 1) * RowNum + r]) / (2.0 * step);
+						jacobian[(t * RowNum + r) * ParamNum + j] = derivative;
+						grad[t * ParamNum + j] += derivative * joint_diff[t * RowNum + r];
+					}
+					grad_frame[t * ParamNum + j] = grad[t * ParamNum + j];
+					for (int e = 0; e < FrameNum; e++)
+						grad_frame[t * ParamNum + j] += (frame_step[2 * j * FrameNum + e] - frame_step[(2 * j + 1) * FrameNum + e]) / (2.0 * step) * frame_diff[t * FrameNum + e];
+				}
+			}
+		}) / pose_num;
+		return true;
+	}
+};
+
+template <typename Dtype>
+bool Check(const char *dir, const char *precision, int pose_num, const std::vector<double> &dof_double, const std::vector<double> &joint_diff_double,
+	const std::vector<double> &frame_diff_double, const NumericGradient &numeric)
+{
+	const double tolerance = GradientTolerance<Dtype>::value();
+	HandKinematics<Dtype> kinematics;
+	if (!kinematics.LoadConfiguration(dir)) return false;
+	std::vector<Dtype> dof(dof_double.begin(), dof_double.end()), joint_diff(joint_diff_double.begin(), joint_diff_double.end());
+	std::vector<Dtype> frame_diff(frame_diff_double.begin(), frame_diff_double.end());
+	std::vector<Dtype> joint(pose_num * RowNum), grad_adjoint(pose_num * ParamNum), grad_frame(pose_num * ParamNum);
+	std::vector<double> grad_jacobian(pose_num * ParamNum);
+
+	//1. time of each path for the gradient of the whole set of poses
+	kinematics.Reshape(pose_num);
+	double time_forward = Time([&]() { kinematics.Forward(pose_num, &dof[0], ParamNum, &joint[0], RowNum); }) / pose_num;
+	double time_adjoint = Time([&]() { kinematics.Backward(pose_num, &dof[0], ParamNum, &joint_diff[0], RowNum, &grad_adjoint[0], ParamNum); }) / pose_num;
+	double time_jacobian = Time([&]()
+	{
+		for (int t = 0; t < pose_num; t++) kinematics.ReferenceGradient(&dof[t * ParamNum], &joint_diff[t * RowNum], &grad_jacobian[t * ParamNum]);
+	}) / pose_num;
+	kinematics.Backward(pose_num, &dof[0], ParamNum, &joint_diff[0], RowNum, &grad_frame[0], ParamNum, &frame_diff[0], FrameNum);
+
+	//2. the whole Jacobian from Backward, one unit joint_diff per row
+	std::vector<Dtype> dof_row(RowNum * ParamNum), joint_row(RowNum * RowNum), unit(RowNum * RowNum, (Dtype)0.0), jacobian(RowNum * ParamNum);
+	for (int r = 0; r < RowNum; r++) unit[r * RowNum + r] = (Dtype)1.0;
+	double max_error[ParamNum], max_value[ParamNum];
+	int worst_joint[ParamNum];
+	for (int j = 0; j < ParamNum; j++) { max_error[j] = 0.0; max_value[j] = 0.0; worst_joint[j] = -1; }
+	for (int t = 0; t < pose_num; t++)
+	{
+		for (int r = 0; r < RowNum; r++) for (int k = 0; k < ParamNum; k++) dof_row[r * ParamNum + k] = dof[t * ParamNum + k];
+		kinematics.Forward(RowNum, &dof_row[0], ParamNum, &joint_row[0], RowNum);
+		kinematics.Backward(RowNum, &dof_row[0], ParamNum, &unit[0], RowNum, &jacobian[0], ParamNum);
+		for (int r = 0; r < RowNum; r++)
+			for (int j = 0; j < ParamNum; j++)
+			{
+				double analytic = jacobian[r * ParamNum + j], error = fabs(analytic - numeric.jacobian[(t * RowNum + r) * ParamNum + j]);
+				max_value[j] = std::max(max_value[j], fabs(analytic));
+				if (error > max_error[j] || worst_joint[j] == -1)
+				{
+					max_error[j] = std::max(max_error[j], error);
+					worst_joint[j] = r / 3;
+				}
+			}
+	}
+
+	double max_grad_error[3] = { 0.0, 0.0, 0.0 }; //Backward, ReferenceGradient and Backward with frame_diff against central differences
+	for (int i = 0; i < pose_num * ParamNum; i++)
+	{
+		max_grad_error[0] = std::max(max_grad_error[0], fabs(grad_adjoint[i] - numeric.grad[i]));
+		max_grad_error[1] = std::max(max_grad_error[1], fabs(grad_jacobian[i] - numeric.grad[i]));
+		max_grad_error[2] = std::max(max_grad_error[2], fabs(grad_frame[i] - numeric.grad_frame[i]));
+	}
+
+	printf("%s, tolerance %g\n", precision, tolerance);
+	printf("dof  max |d joint / d dof|  max error  worst joint\n");
+	bool pass = true;
+	for (int j = 0; j < ParamNum; j++)
+	{
+		printf("%3d  %20.6g  %9.3g  %11d%s\n", j, max_value[j], max_error[j], worst_joint[j], max_error[j] > tolerance ? "  FAIL" : "");
+		if (max_error[j] > tolerance) pass = false;
+	}
+	printf("gradient of a random joint_diff, max error against central differences : Backward %.3g, ReferenceGradient %.3g\n", max_grad_error[0], max_grad_error[1]);
+	printf("with a random frame_diff as well : Backward %.3g\n", max_grad_error[2]);
+	if (max_grad_error[0] > tolerance || max_grad_error[1] > tolerance || max_grad_error[2] > tolerance) pass = false;
+	printf("time per pose (us) : Forward %.3f, Backward %.3f, ReferenceGradient %.3f, central differences (double) %.3f\n",
+		time_forward * 1e6, time_adjoint * 1e6, time_jacobian * 1e6, numeric.time * 1e6);
+	printf("%s %s\n\n", precision, pass ? "PASS" : "FAIL");
+	return pass;
+}
+
+//One instance per thread, created and run inside a parallel region of the caller
+bool CheckPerThread(const char *dir, int pose_num, const std::vector<double> &dof, const std::vector<double> &joint_diff, const NumericGradient &numeric)
+{
+	const double tolerance = GradientTolerance<double>::value();
+	int thread_num = 1;
+	bool loaded = true;
+	double max_error[2] = { 0.0, 0.0 }; //Backward and ReferenceGradient against central differences
+#ifdef _OPENMP
+	#pragma omp parallel
+#endif
+	{
+		HandKinematics<double> kinematics;
+		std::vector<double> joint(pose_num * RowNum), grad(pose_num * ParamNum), grad_reference(pose_num * ParamNum);
+		bool ok = kinematics.LoadConfiguration(dir);
+		if (ok)
+		{
+			kinematics.Forward(pose_num, &dof[0], ParamNum, &joint[0], RowNum);
+			kinematics.Backward(pose_num, &dof[0], ParamNum, &joint_diff[0], RowNum, &grad[0], ParamNum);
+			for (int t = 0; t < pose_num; t++) kinematics.ReferenceGradient(&dof[t * ParamNum], &joint_diff[t * RowNum], &grad_reference[t * ParamNum]);
+		}
+	#ifdef _OPENMP
+		#pragma omp critical
+	#endif
+		{
+		#ifdef _OPENMP
+			thread_num = std::max(thread_num, omp_get_num_threads());
+		#endif
+			loaded = loaded && ok;
+			for (int i = 0; ok && i < pose_num * ParamNum; i++)
+			{
+				max_error[0] = std::max(max_error[0], fabs(grad[i] - numeric.grad[i]));
+				max_error[1] = std::max(max_error[1], fabs(grad_reference[i] - numeric.grad[i]));
+			}
+		}
+	}
+	bool pass = loaded && max_error[0] <= tolerance && max_error[1] <= tolerance;
+	printf("one instance per thread (%d threads), max error against central differences : Backward %.3g, ReferenceGradient %.3g\n", thread_num, max_error[0], max_error[1]);
+	printf("per thread %s\n\n", pass ? "PASS" : "FAIL");
+	return pass;
+}
+
+//Forward, then every pose changed in place, then Backward of the same buffer: the same gradient as a fresh instance
+bool CheckChangedInPlace(const char *dir, int pose_num, const std::vector<double> &dof_double, const std::vector<double> &joint_diff)
+{
+	HandKinematics<double> kinematics, fresh;
+	if (!kinematics.LoadConfiguration(dir) || !fresh.LoadConfiguration(dir)) return false;
+	std::vector<double> dof(dof_double), joint(pose_num * RowNum), grad(pose_num * ParamNum), grad_fresh(pose_num * ParamNum);
+	kinematics.Forward(pose_num, &dof[0], ParamNum, &joint[0], RowNum);
+	for (int i = 0; i < (int)dof.size(); i++) dof[i] += 0.25;
+	kinematics.Backward(pose_num, &dof[0], ParamNum, &joint_diff[0], RowNum, &grad[0], ParamNum);
+	fresh.Backward(pose_num, &dof[0], ParamNum, &joint_diff[0], RowNum, &grad_fresh[0], ParamNum);
+	double max_error = 0.0;
+	for (int i = 0; i < pose_num * ParamNum; i++) max_error = std::max(max_error, fabs(grad[i] - grad_fresh[i]));
+	bool pass = max_error == 0.0;
+	printf("poses changed in place between Forward and Backward, max difference to a fresh instance : %.3g\n", max_error);
+	printf("changed in place %s\n\n", pass ? "PASS" : "FAIL");
+	return pass;
+}
+
+int main(int argc, char **argv)
+{
+	const char *dir = argc > 1 ? argv[1] : "configuration";
+	const int pose_num = argc > 2 ? atoi(argv[2]) : 64;
+	const double step = argc > 3 ? atof(argv[3]) : 1e-5;
+	if (pose_num <= 0) return 1;
+
+	//poses exactly representable in float, so both precisions see the same pose
+	CRandom<double> crand(1);
+	std::vector<double> dof(pose_num * ParamNum), joint_diff(pose_num * RowNum), frame_diff(pose_num * FrameNum);
+	for (int i = 0; i < (int)dof.size(); i++) dof[i] = (float)crand.Gaussian(0.0, 0.5);
+	for (int i = 0; i < (int)joint_diff.size(); i++) joint_diff[i] = (float)crand.Gaussian();
+	for (int i = 0; i < (int)frame_diff.size(); i++) frame_diff[i] = (float)crand.Gaussian();
+	NumericGradient numeric;
+	if (!numeric.Compute(dir, pose_num, step, dof, joint_diff, frame_diff)) return 1;
+	printf("%d poses, central difference step %g\n\n", pose_num, step);
+
+	bool pass = Check<double>(dir, "double", pose_num, dof, joint_diff, frame_diff, numeric);
+	pass = Check<float>(dir, "float", pose_num, dof, joint_diff, frame_diff, numeric) && pass;
+	pass = CheckPerThread(dir, pose_num, dof, joint_diff, numeric) && pass;
+	pass = CheckChangedInPlace(dir, pose_num, dof, joint_diff) && pass;
+	printf("%s\n", pass ? "PASS" : "FAIL");
+	return pass ? 0 : 1;
+}
@@ -0,0 +1,19 @@
+//Parses the text configuration of the hand model once and saves it as HandModel.bundle in the same directory,
+//which HandModelConfig::Get then reads instead of the text files (until one of them is changed, run it again then)
+//usage: hand_model_bundle [configuration dir]
+#include <cstdio>
+#include <string>
+#include "HandModelConfig.h"
+
+using namespace hand_model;
+
+int main(int argc, char **argv)
+{
+	std::string dir = argc > 1 ? argv[1] : "configuration";
+	HandModelConfig config;
+	if (!config.LoadText(dir)) return 1;
+	std::string bundle = dir + "/" + HandModelConfig::BundleName;
+	if (!config.SaveBundle(bundle)) return 1;
+	printf("saved %s (%s DoF bounds)\n", bundle.c_str(), config.has_bound ? "with" : "without");
+	return 0;
+}
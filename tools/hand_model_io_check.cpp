@@ -0,0 +1,126 @@
+//Round trips of the binary formats in common/Utility, in a scratch directory
+//usage: hand_model_io_check [scratch dir]
+//  rows/cols files (FileIOUtility.h) : SaveBinary, then LoadBinary (MappedBinary) and BinaryRowReader for several batch and
+//  read-ahead sizes must give back every value, also for 0 rows or 0 cols, and BinaryRowReader must fail on a truncated file
+//  arrays (iostream_binary.h) : write_array, then read_array of Matrix4, Vector4, scalars and items of value_type scalars
+//  must give back every value, and read_array of another item type must fail
+//The return value is 1 if any round trip fails.
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Utility/FileIOUtility.h"
+#include "Utility/iostream_binary.h"
+#include "numeric/matrix4.h"
+#include "numeric/vector4.h"
+
+using namespace numeric;
+
+struct ArrayItem { typedef double value_type; double v[3]; };
+
+//rows x cols values saved, then read back whole and batch by batch
+bool CheckRowsCols(const std::string &file, unsigned int rows, unsigned int cols)
+{
+	std::vector<float> data((size_t)rows * cols + 1); //one more, so &data[0] is valid for 0 values as well
+	for (size_t i = 0; i < data.size(); i++) data[i] = i * 0.5f - 7.0f;
+	if (!SaveBinary(file.c_str(), &data[0], rows, cols)) return false;
+
+	bool pass = true;
+	MappedBinary<float> view;
+	unsigned int view_rows, view_cols;
+	if (!LoadBinary(file.c_str(), view, view_rows, view_cols) || view_rows != rows || view_cols != cols) pass = false;
+	for (size_t i = 0; pass && i < (size_t)rows * cols; i++) pass = view.data()[i] == data[i];
+	view.Close();
+
+	const unsigned int batch_list[] = { 1, 7, rows > 0 ? rows : 1, rows + 5 }, queue_list[] = { 1, 2 };
+	for (int b = 0; b < 4; b++)
+		for (int q = 0; q < 2; q++)
+		{
+			BinaryRowReader<float> reader;
+			if (!reader.Open(file.c_str(), batch_list[b], queue_list[q]) || reader.rows != rows || reader.cols != cols) { pass = false; continue; }
+			const float *batch;
+			unsigned int count, read = 0;
+			while (reader.Next(batch, count))
+			{
+				for (size_t i = 0; i < (size_t)count * cols; i++)
+					if (batch[i] != data[(size_t)read * cols + i]) pass = false;
+				read += count;
+			}
+			if (read != rows) pass = false;
+		}
+	printf("rows/cols file %u x %u : %s\n", rows, cols, pass ? "PASS" : "FAIL");
+	return pass;
+}
+
+//a file shorter than its rows and cols say must end the batches with a failure, not give back garbage
+bool CheckTruncated(const std::string &file)
+{
+	const unsigned int rows = 100, cols = 3;
+	std::vector<float> data(rows * cols, 1.0f);
+	{
+		ofstream out(file.c_str(), ios::out | ios::binary);
+		out.write((const char*)&rows, sizeof(rows));
+		out.write((const char*)&cols, sizeof(cols));
+		out.write((const char*)&data[0], data.size() / 2 * sizeof(float));
+	}
+	BinaryRowReader<float> reader;
+	const float *batch;
+	unsigned int count, read = 0;
+	if (reader.Open(file.c_str(), 16))
+		while (reader.Next(batch, count)) read += count;
+	bool pass = read < rows;
+	printf("truncated rows/cols file, %u of %u rows read : %s\n", read, rows, pass ? "PASS" : "FAIL");
+	return pass;
+}
+
+template <typename Type>
+bool SameArray(const std::vector<Type> &a, const std::vector<Type> &b)
+{
+	typedef typename binary_array_scalar<Type>::type value_type;
+	if (a.size() != b.size()) return false;
+	const value_type *pa = a.empty() ? NULL : (const value_type*)&a[0], *pb = b.empty() ? NULL : (const value_type*)&b[0];
+	for (size_t i = 0; i < a.size() * sizeof(Type) / sizeof(value_type); i++)
+		if (pa[i] != pb[i]) return false;
+	return true;
+}
+
+bool CheckArrays()
+{
+	std::vector<Matrix4<double> > matrices(50), matrices_read;
+	std::vector<Vector4<float> > vectors(70), vectors_read;
+	std::vector<int> scalars(90), scalars_read;
+	std::vector<ArrayItem> items(1000), items_read, empty, empty_read(3);
+	std::vector<Matrix4<float> > wrong_read;
+	for (int i = 0; i < (int)matrices.size(); i++) matrices[i] = Matrix4<double>(rot_x, i * 0.1) * Matrix4<double>(trans_z, i);
+	for (int i = 0; i < (int)vectors.size(); i++) vectors[i] = Vector4<float>((float)i, i * 0.5f, -i * 0.25f, 1.0f);
+	for (int i = 0; i < (int)scalars.size(); i++) scalars[i] = i * 37 - 1000;
+	for (int i = 0; i < (int)items.size(); i++) for (int k = 0; k < 3; k++) items[i].v[k] = i * 3.5 - k;
+
+	ostringstream oss;
+	ostream_binary out(oss);
+	out.write_array(matrices).write_array(vectors).write_array(scalars).write_array(items).write_array(empty).write_array(matrices);
+	istringstream iss(oss.str());
+	istream_binary in(iss);
+	in.read_array(matrices_read).read_array(vectors_read).read_array(scalars_read).read_array(items_read).read_array(empty_read);
+	bool pass = !!iss && SameArray(matrices, matrices_read) && SameArray(vectors, vectors_read) && SameArray(scalars, scalars_read)
+		&& SameArray(items, items_read) && empty_read.empty();
+	in.read_array(wrong_read); //Matrix4<double> written, Matrix4<float> read
+	bool wrong_fails = !in;
+	printf("write_array / read_array : %s, another item type read : %s\n", pass ? "PASS" : "FAIL", wrong_fails ? "PASS" : "FAIL");
+	return pass && wrong_fails;
+}
+
+int main(int argc, char **argv)
+{
+	const std::string dir = argc > 1 ? argv[1] : ".";
+	const std::string file = dir + "/hand_model_io_check.bin";
+	bool pass = CheckRowsCols(file, 1000, 47);
+	pass = CheckRowsCols(file, 13, 1) && pass;
+	pass = CheckRowsCols(file, 0, 47) && pass;
+	pass = CheckRowsCols(file, 20, 0) && pass;
+	pass = CheckTruncated(file) && pass;
+	pass = CheckArrays() && pass;
+	remove(file.c_str());
+	printf("%s\n", pass ? "PASS" : "FAIL");
+	return pass ? 0 : 1;
+}